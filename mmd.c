@@ -51,7 +51,15 @@
 #include "mmd.h"
 #include <stdlib.h>
 #include <ctype.h>
+#include <errno.h>
 #include <string.h>
+#if _WIN32
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#  include <time.h>
+#  include <unistd.h>
+#endif // _WIN32
 
 
 //
@@ -70,6 +78,31 @@
 #endif // _WIN32
 
 
+//
+// Constants...
+//
+
+#define MMD_CHUNK_MIN	16384		// Minimum size of memory chunks
+#define MMD_CHUNK_BLOCK	256		// Minimum size of top-level block chunks
+#define MMD_NODES_MAX	11		// Number of indexed node types + outline
+#define MMD_NODES_OUTLINE 10		// Index of outline (all headings)
+#define MMD_CHUNK_MAX	1048576		// Maximum size of memory chunks
+#define MMD_BINARY_VERSION 1		// Version of binary document format
+#define MMD_BINARY_HEADER 16		// Size of binary header
+#define MMD_BINARY_RECORD 12		// Size of binary node record
+#define MMD_BINARY_NONE	0xffffffff	// No parent in binary node record
+#define MMD_BINARY_WHITESPACE 0x01	// Node has leading whitespace
+#define MMD_BINARY_TEXT	0x02		// Node has text
+#define MMD_BINARY_URL	0x04		// Node has a URL
+#define MMD_BINARY_EXTRA 0x08		// Node has extra text
+#ifndef MMD_FEED_MIN
+#  define MMD_FEED_MIN 16384		// Minimum size of incremental load parts
+#endif // !MMD_FEED_MIN
+#ifndef MMD_PARALLEL_MIN
+#  define MMD_PARALLEL_MIN 65536	// Minimum size of parallel load parts
+#endif // !MMD_PARALLEL_MIN
+
+
 //
 // Private structures...
 //
@@ -77,10 +110,12 @@
 struct _mmd_s
 {
   mmd_type_t	type;			// Node type
-  bool		whitespace;		// Leading whitespace?
-  char		*text,			// Text
+  bool		whitespace,		// Leading whitespace?
+		lazy;			// Inline text not parsed yet?
+  char		*text,			// Text or unparsed inline text
 		*url,			// Reference URL (image/link/etc.)
 		*extra;			// Title, language name, etc.
+  size_t	textlen;		// Length of text
   mmd_t		*parent,		// Parent node
 		*first_child,		// First child node
 		*last_child,		// Last child node
@@ -95,6 +130,10 @@ typedef struct _mmd_filebuf_s		// Buffered file
   char		buffer[65536],		// Buffer
 		*bufptr,		// Pointer into buffer
 		*bufend;		// End of buffer
+  size_t	bytes,			// Total bytes read
+		lines,			// Number of lines read
+		refills;		// Number of buffer refills
+  bool		overflow;		// Input byte limit exceeded?
 } _mmd_filebuf_t;
 
 typedef struct _mmd_ref_s		// Reference link
@@ -102,17 +141,167 @@ typedef struct _mmd_ref_s		// Reference link
   char		*name,			// Name of reference
 		*url,			// Reference URL
 		*title;			// Title, if any
-  size_t	num_pending;		// Number of pending nodes
+  size_t	num_pending,		// Number of pending nodes
+		alloc_pending;		// Allocated pending nodes
   mmd_t		**pending;		// Pending nodes
 } _mmd_ref_t;
 
+typedef struct _mmd_chunk_s		// Memory chunk for nodes and strings
+{
+  struct _mmd_chunk_s *next;		// Next (older) chunk
+  size_t	size,			// Size of chunk data
+		used;			// Bytes used in chunk
+} _mmd_chunk_t;
+
+typedef struct _mmd_held_s		// Unreported top-level block
+{
+  mmd_t		*block;			// Block or `NULL` if reported
+  _mmd_chunk_t	*chunks;		// Memory chunks for block
+} _mmd_held_t;
+
+typedef struct _mmd_nodes_s		// Indexed nodes of one type
+{
+  size_t	num_nodes,		// Number of nodes
+		alloc_nodes;		// Allocated nodes
+  mmd_t		**nodes;		// Nodes in the order they were added
+} _mmd_nodes_t;
+
+typedef struct _mmd_defer_s		// Deferred reference
+{
+  mmd_t		*node;			// Link node, if any
+  char		*name,			// Name of reference
+		*url,			// Reference URL, if any
+		*title;			// Title, if any
+} _mmd_defer_t;
+
 typedef struct _mmd_doc_s		// Markdown document
 {
-  mmd_t		*root;			// Root node
-  size_t	num_references;		// Number of references
+  mmd_t		node;			// Document node (must be first)
+  mmd_alloc_cb_t alloc_cb;		// Allocator function, if any
+  void		*alloc_data;		// Allocator data
+  mmd_strings_t	*strings;		// String table, if any
+  mmd_t		*root;			// Root node for current load
+  bool		loading,		// Load in progress?
+		frozen,			// Document frozen by mmdFreeze?
+		defer_refs,		// Defer references to mmdLoadParallel?
+		no_metadata,		// Disable metadata detection?
+		in_fence,		// Load ended inside a code fence?
+		in_metadata;		// Load ended inside metadata?
+  _mmd_chunk_t	*chunks,		// Memory chunks
+		*spare;			// Spare memory chunks
+  mmd_t		*free_nodes;		// Freed nodes for reuse
+  mmd_block_cb_t doc_block_cb;		// Block callback set with mmdSetBlockCallback
+  void		*doc_block_data;	// Block callback data set with mmdSetBlockCallback
+  mmd_block_cb_t block_cb;		// Block callback for current load, if any
+  void		*block_data;		// Block callback data for current load
+  mmd_t		*block_next;		// Next top-level block to report
+  bool		block_freed;		// Has the block callback freed a block?
+  size_t	first_held,		// First unreported block
+		num_held,		// Number of unreported blocks
+		alloc_held,		// Allocated unreported blocks
+		cur_held;		// Unreported block for allocations (index + 1) or 0
+  _mmd_held_t	*held;			// Unreported blocks and their memory
+  size_t	num_references,		// Number of references
+		alloc_references,	// Allocated references
+		num_pending;		// Number of pending links
   _mmd_ref_t	*references;		// References
+  size_t	alloc_refhash,		// Size of reference hash table (power of 2)
+		*refhash;		// Reference hash table (index + 1) or 0
+  size_t	num_lazy;		// Number of blocks with unparsed inline text
+  size_t	num_nodes;		// Number of nodes added
+  bool		index_nodes,		// Index nodes by type?
+		unsorted_nodes;		// Are indexed nodes out of document order?
+  size_t	num_indexed;		// Number of indexed nodes
+  _mmd_nodes_t	nodes[MMD_NODES_MAX];	// Indexed nodes by type
+  size_t	num_headings,		// Number of outline headings with text
+		alloc_headings;		// Allocated outline headings
+  mmd_heading_t	*headings;		// Outline headings
+  mmd_t		*inline_parent;		// Current parent of inline nodes
+  char		*inline_start,		// Start of inline text being parsed
+		*inline_end;		// End of inline text being parsed
+  size_t	num_inline;		// Number of inline nodes in parent
+  size_t	num_deferred,		// Number of deferred references
+		alloc_deferred;		// Allocated deferred references
+  _mmd_defer_t	*deferred;		// Deferred references
+  size_t	alloc_delims,		// Allocated delimiter positions
+		*delims;		// Delimiter positions in current line
+  mmd_t		*code_block;		// Code block for buffered text
+  size_t	code_len,		// Length of buffered code text
+		code_alloc;		// Allocated size of code text buffer
+  char		*code;			// Buffered code text
+  int		error;			// Error code (errno value), if any
+  mmd_stats_t	stats;			// Parse statistics
 } _mmd_doc_t;
 
+typedef struct _mmd_index_s		// Closing delimiter index for a line
+{
+  char		*start;			// Start of indexed text or `NULL`
+  size_t	num_delims,		// Number of delimiter positions
+		next[8];		// Next position to check for each delimiter
+} _mmd_index_t;
+
+typedef struct _mmd_membuf_s		// Memory buffer
+{
+  const char	*ptr,			// Pointer into buffer
+		*end;			// End of buffer
+} _mmd_membuf_t;
+
+#if _WIN32
+typedef CRITICAL_SECTION _mmd_mutex_t;	// Mutual exclusion lock
+typedef HANDLE _mmd_thread_t;		// Thread
+#else
+typedef pthread_mutex_t _mmd_mutex_t;	// Mutual exclusion lock
+typedef pthread_t _mmd_thread_t;	// Thread
+#endif // _WIN32
+
+struct _mmd_strings_s			// String table
+{
+  mmd_alloc_cb_t alloc_cb;		// Allocator function, if any
+  void		*alloc_data;		// Allocator data
+  _mmd_mutex_t	mutex;			// Lock for loads in other threads
+  size_t	num_strings,		// Number of strings
+		alloc_strings;		// Size of hash table (power of 2)
+  char		**strings;		// Hash table of strings
+  _mmd_chunk_t	*chunks;		// Memory chunks for strings
+};
+
+typedef struct _mmd_part_s		// Part of a parallel load
+{
+  const char	*start,			// Start of part
+		*end;			// End of part
+  bool		no_metadata;		// Disable metadata detection?
+  _mmd_doc_t	*parent,		// Document being loaded
+		*doc;			// Document for part
+  _mmd_thread_t	thread;			// Thread loading part
+  bool		started;		// Was the thread started?
+} _mmd_part_t;
+
+typedef struct _mmd_split_s		// Split state for a buffer
+{
+  char		fence;			// Current fence character
+  size_t	fencelen;		// Length of current fence
+  bool		blank,			// Was the previous line blank?
+		quoted,			// Is the current fence in a block quote?
+		metadata,		// Can metadata still start?
+		in_metadata;		// Is the current line in metadata?
+} _mmd_split_t;
+
+struct _mmd_parser_s			// Incremental markdown parser
+{
+  _mmd_doc_t	*doc;			// Document
+  mmd_t		*root,			// Root node passed to mmdParserNew
+		*last;			// Last node before load
+  bool		empty;			// Metadata still possible?
+  char		*buffer;		// Text that has not been loaded
+  size_t	used,			// Bytes in buffer
+		alloc,			// Allocated size of buffer
+		bytes,			// Total bytes fed
+		scanned,		// Bytes checked for places to split
+		split_at,		// Last place to split
+		min_split;		// Minimum place to split after a failed load
+  _mmd_split_t	split;			// Split state for the checked bytes
+};
+
 typedef struct _mmd_stack_s		// Markdown block stack
 {
   mmd_t		*parent;		// Parent node
@@ -126,6 +315,8 @@ typedef struct _mmd_stack_s		// Markdown block stack
 // Local globals...
 //
 
+static size_t		mmd_limits[MMD_LIMIT_INLINE + 1] = { 0 };
+					// Parse limits (0 = unlimited)
 static mmd_option_t	mmd_options = MMD_OPTION_ALL;
 					// Markdown extensions to support
 
@@ -134,21 +325,68 @@ static mmd_option_t	mmd_options = MMD_OPTION_ALL;
 // Local functions...
 //
 
-static mmd_t	*mmd_add(mmd_t *parent, mmd_type_t type, int whitespace, char *text, char *url);
+static mmd_t	*mmd_add(_mmd_doc_t *doc, mmd_t *parent, mmd_type_t type, int whitespace, char *text, char *url);
+static void	mmd_add_code(_mmd_doc_t *doc, mmd_t *parent, const char *text);
+static void	mmd_add_inline(_mmd_doc_t *doc, mmd_t *parent, char *lineptr);
+static void	*mmd_alloc(_mmd_doc_t *doc, size_t bytes);
+static size_t	mmd_binary_get(const unsigned char *buffer);
+static void	mmd_binary_put(unsigned char *buffer, size_t value);
+static void	mmd_block_chunks(_mmd_doc_t *doc, size_t cur, bool keep);
+static void	mmd_block_done(_mmd_doc_t *doc, bool all);
+static mmd_t	*mmd_block_top(_mmd_doc_t *doc, mmd_t *node);
+static _mmd_doc_t *mmd_doc(mmd_t *node);
+static char	*mmd_find_delim(_mmd_doc_t *doc, _mmd_index_t *index, char *lineptr, const char *delim, size_t delimlen);
+static void	mmd_flush_code(_mmd_doc_t *doc);
 static void	mmd_free(mmd_t *node);
+static void	mmd_free_nodes(_mmd_doc_t *doc, mmd_t *node);
 static int	mmd_has_continuation(const char *line, _mmd_filebuf_t *file, int indent);
+static size_t	mmd_iocb_buffer(_mmd_membuf_t *buf, char *buffer, size_t bytes);
 static size_t	mmd_iocb_file(FILE *fp, char *buffer, size_t bytes);
-static size_t	mmd_iocb_string(const char **s, char *buffer, size_t bytes);
+static size_t	mmd_iocb_line(FILE *fp, char *buffer, size_t bytes);
 static size_t	mmd_is_chars(const char *lineptr, const char *chars, size_t minchars);
 static size_t	mmd_is_codefence(char *lineptr, char fence, size_t fencelen, char **language);
 static bool	mmd_is_table(_mmd_filebuf_t *file, int indent);
+static _mmd_doc_t *mmd_load_begin(mmd_t *root);
+static char	*mmd_intern(_mmd_doc_t *doc, const char *s);
+static mmd_t	*mmd_load_end(_mmd_doc_t *doc, mmd_t *root, mmd_t *last);
+static void	mmd_nodes_add(_mmd_doc_t *doc, mmd_t *node);
+static void	mmd_nodes_append(_mmd_doc_t *doc, _mmd_nodes_t *nodes, mmd_t *node);
+static void	mmd_nodes_check(_mmd_doc_t *doc);
+static size_t	mmd_nodes_delete(_mmd_doc_t *doc, _mmd_nodes_t *nodes, mmd_t *node);
+static _mmd_nodes_t *mmd_nodes_find(_mmd_doc_t *doc, mmd_type_t type);
+static void	mmd_nodes_rebuild(_mmd_doc_t *doc);
+static void	mmd_nodes_remove(_mmd_doc_t *doc, mmd_t *node);
+static bool	mmd_parallel_line(_mmd_split_t *split, const char *ptr, const char *next);
+static void	mmd_parallel_load(_mmd_part_t *part);
+static void	mmd_parallel_merge(_mmd_doc_t *doc, _mmd_doc_t *partdoc);
+static size_t	mmd_parallel_split(const char *buffer, size_t bytes, size_t max_parts, _mmd_part_t *parts, bool metadata);
+#if _WIN32
+static DWORD WINAPI mmd_parallel_thread(LPVOID data);
+#else
+static void	*mmd_parallel_thread(void *data);
+#endif // _WIN32
 static void	mmd_parse_inline(_mmd_doc_t *doc, mmd_t *parent, char *lineptr);
+static void	mmd_parse_lazy(_mmd_doc_t *doc, mmd_t *node);
 static char	*mmd_parse_link(_mmd_doc_t *doc, char *lineptr, char **text, char **url, char **title, char **refname);
+static bool	mmd_parser_load(mmd_parser_t *parser, size_t bytes, bool finish);
+static void	*mmd_realloc(_mmd_doc_t *doc, void *ptr, size_t bytes);
 static void	mmd_read_buffer(_mmd_filebuf_t *file);
 static char	*mmd_read_line(_mmd_filebuf_t *file, char *line, size_t linesize);
 static void	mmd_ref_add(_mmd_doc_t *doc, mmd_t *node, const char *name, const char *url, const char *title);
+static void	mmd_ref_clear(_mmd_doc_t *doc);
 static _mmd_ref_t *mmd_ref_find(_mmd_doc_t *doc, const char *name);
+static size_t	mmd_ref_hash(_mmd_doc_t *doc, const char *name);
+static char	*mmd_ref_strdup(_mmd_doc_t *doc, mmd_t *node, const char *s);
+static void	mmd_release(_mmd_doc_t *doc, void *ptr);
 static void	mmd_remove(mmd_t *node);
+static char	*mmd_strdup(_mmd_doc_t *doc, const char *s);
+static char	*mmd_strings_add(mmd_strings_t *strings, const char *s);
+static size_t	mmd_strings_hash(const char *s);
+static void	*mmd_strings_realloc(mmd_strings_t *strings, void *ptr, size_t bytes);
+static char	*mmd_strndup(_mmd_doc_t *doc, const char *s, size_t len);
+static double	mmd_time(void);
+static char	*mmd_unescape(char *s);
+static mmd_t	*mmd_walk(mmd_t *top, mmd_t *current, size_t *depth);
 #if DEBUG
 static const char *mmd_type_string(mmd_type_t type);
 #endif // DEBUG
@@ -157,7 +395,8 @@ static const char *mmd_type_string(mmd_type_t type);
 //
 // 'mmdCopyAllText()' - Make a copy of all the text under a given node.
 //
-// The returned string must be freed using free().
+// The returned string must be freed using free(), or using the allocator that
+// was passed to `mmdNew` when the document was created.
 //
 
 char *					// O - Copied string
@@ -170,24 +409,26 @@ mmdCopyAllText(mmd_t *node)		// I - Parent node
 		textlen;		// Length of "text" string
   mmd_t		*current,		// Current node
 		*next;			// Next node
+  _mmd_doc_t	*doc;			// Document
 
 
+  doc     = node ? mmd_doc(node) : NULL;
   current = mmdGetFirstChild(node);
 
-  while (current != node)
+  while (current && current != node)
   {
-    if (current->text)
+    if (current->text && !current->lazy)
     {
       // Append this node's text to the string...
       long alloff = allptr - all;	// Offset within current buffer
 
-      textlen = strlen(current->text);
+      textlen = current->textlen;
       allsize += textlen + (size_t)current->whitespace;
-      temp    = realloc(all, allsize);
+      temp    = mmd_realloc(doc, all, allsize + 1);
 
       if (!temp)
       {
-	free(all);
+	mmd_release(doc, all);
 	return (NULL);
       }
 
@@ -226,39 +467,214 @@ mmdCopyAllText(mmd_t *node)		// I - Parent node
 //
 // 'mmdFree()' - Free a markdown tree.
 //
+// Nodes and strings are allocated in chunks owned by the document, so freeing
+// the document root releases everything at once.  Freeing any other node
+// removes it from the tree and keeps its nodes for reuse by later loads - the
+// rest of its memory is released with the document.
+//
 
 void
 mmdFree(mmd_t *node)			// I - First node
 {
-  mmd_t *current,			// Current node
-	*next;				// Next node
+  _mmd_doc_t	*doc;			// Document
+  mmd_t		*current;		// Current node
+  size_t	depth = 0;		// Depth of current node
+
+
+  if (!node)
+    return;
+
+  if (!node->parent)
+  {
+    mmd_free(node);
+    return;
+  }
+
+  // Nodes in a frozen document cannot be freed on their own...
+  if ((doc = mmd_doc(node)) != NULL && doc->frozen)
+    return;
 
+  // Remove the nodes from the document's index, if any...
+  if (doc && doc->num_indexed)
+  {
+    for (current = node; current; current = mmd_walk(node, current, &depth))
+      mmd_nodes_remove(doc, current);
+  }
 
   mmd_remove(node);
 
-  for (current = node->first_child; current; current = next)
+  if (doc)
+    mmd_free_nodes(doc, node);
+}
+
+
+//
+// 'mmdFreeze()' - Copy a document into a single block of memory.
+//
+// The nodes are copied in depth-first order followed by their strings, so
+// walking the document reads memory in order.  Any unparsed inline text is
+// parsed first and the document can no longer be changed, so it can be read
+// from multiple threads at the same time.  `mmdReset` makes the document
+// loadable again.
+//
+// Pointers to nodes other than the document root are not valid after the
+// document is frozen.
+//
+
+bool					// O - `true` on success, `false` on error
+mmdFreeze(mmd_t *doc)			// I - Document root node
+{
+  _mmd_doc_t	*d;			// Document
+  _mmd_chunk_t	*chunk,			// New chunk
+		*next;			// Next chunk
+  mmd_t		*current,		// Current node
+		*node,			// New node
+		*nodes,			// New nodes
+		**parents;		// Last new node at each depth
+  char		*pool;			// New strings
+  size_t	num_nodes = 0,		// Number of nodes
+		pool_size = 0,		// Size of strings
+		depth = 0,		// Depth of current node
+		max_depth = 0,		// Maximum depth of nodes
+		len;			// Length of string
+
+
+  if (!doc || doc->type != MMD_TYPE_DOCUMENT || doc->parent || ((_mmd_doc_t *)doc)->loading)
+  {
+    errno = EINVAL;
+    return (false);
+  }
+
+  d = (_mmd_doc_t *)doc;
+
+  if (d->frozen)
+    return (true);
+
+  mmdParseInlines(doc);
+
+  // Count the nodes and string bytes, skipping any strings in the string
+  // table...
+  for (current = mmd_walk(doc, doc, &depth); current; current = mmd_walk(doc, current, &depth))
+  {
+    num_nodes ++;
+
+    if (depth > max_depth)
+      max_depth = depth;
+
+    if (current->text && !(d->strings && current->type == MMD_TYPE_METADATA_TEXT))
+      pool_size += current->textlen + 1;
+    if (current->url && !d->strings)
+      pool_size += strlen(current->url) + 1;
+    if (current->extra && !(d->strings && current->type == MMD_TYPE_CODE_BLOCK))
+      pool_size += strlen(current->extra) + 1;
+  }
+
+  if ((parents = mmd_realloc(d, NULL, (max_depth + 1) * sizeof(mmd_t *))) == NULL)
+    return (false);
+
+  if ((chunk = mmd_realloc(d, NULL, sizeof(_mmd_chunk_t) + num_nodes * sizeof(mmd_t) + pool_size)) == NULL)
+  {
+    mmd_release(d, parents);
+    return (false);
+  }
+
+  chunk->next = NULL;
+  chunk->size = chunk->used = num_nodes * sizeof(mmd_t) + pool_size;
+  nodes       = (mmd_t *)(chunk + 1);
+  pool        = (char *)(nodes + num_nodes);
+  parents[0]  = doc;
+
+  // Copy the nodes in depth-first order, linking each one to the last new node
+  // at the depth above it...
+  current          = mmd_walk(doc, doc, &depth);
+  doc->first_child = doc->last_child = NULL;
+
+  for (node = nodes; current; current = mmd_walk(doc, current, &depth), node ++)
   {
-    // Get the next node...
-    if ((next = current->first_child) != NULL)
+    memset(node, 0, sizeof(mmd_t));
+
+    node->type       = current->type;
+    node->whitespace = current->whitespace;
+    node->textlen    = current->textlen;
+    node->parent     = parents[depth - 1];
+    parents[depth]   = node;
+
+    if (node->parent->last_child)
     {
-      // Free parent nodes after child nodes have been freed...
-      current->first_child = NULL;
-      continue;
+      node->parent->last_child->next_sibling = node;
+      node->prev_sibling                     = node->parent->last_child;
+      node->parent->last_child               = node;
+    }
+    else
+    {
+      node->parent->first_child = node->parent->last_child = node;
+    }
+
+    if (d->strings)
+    {
+      // Keep the strings from the string table...
+      if (current->type == MMD_TYPE_METADATA_TEXT)
+        node->text = current->text;
+      else if (current->type == MMD_TYPE_CODE_BLOCK)
+        node->extra = current->extra;
+
+      node->url = current->url;
+    }
+
+    if (current->text && !node->text)
+    {
+      node->text = pool;
+      memcpy(pool, current->text, current->textlen + 1);
+      pool += current->textlen + 1;
+    }
+
+    if (current->url && !node->url)
+    {
+      len       = strlen(current->url) + 1;
+      node->url = pool;
+      memcpy(pool, current->url, len);
+      pool += len;
     }
 
-    if ((next = current->next_sibling) == NULL)
+    if (current->extra && !node->extra)
     {
-      // Next node is the parent, which we'll free as needed...
-      if ((next = current->parent) == node)
-	next = NULL;
+      len         = strlen(current->extra) + 1;
+      node->extra = pool;
+      memcpy(pool, current->extra, len);
+      pool += len;
     }
+  }
+
+  mmd_release(d, parents);
+
+  // Free the old memory chunks, which also hold any freed nodes and the strings
+  // of the old references...
+  while ((next = d->chunks) != NULL)
+  {
+    d->chunks = next->next;
+    mmd_release(d, next);
+  }
+
+  d->chunks         = chunk;
+  d->root           = doc;
+  d->free_nodes     = NULL;
+  d->inline_parent  = NULL;
+  d->num_references = 0;
+  d->frozen         = true;
+
+  d->stats.chunks ++;
+
+  // Update the node index with the new nodes and copy the outline text so that
+  // mmdGetOutline does not change the frozen document...
+  if (d->num_indexed)
+  {
+    size_t num_headings;		// Number of headings
 
-    // Free child...
-    mmd_free(current);
+    mmd_nodes_rebuild(d);
+    mmdGetOutline(doc, &num_headings);
   }
 
-  // Then free the memory used by the parent node...
-  mmd_free(node);
+  return (true);
 }
 
 
@@ -281,6 +697,9 @@ mmdGetExtra(mmd_t *node)		// I - Node
 mmd_t *					// O - First child or @code NULL@ if none
 mmdGetFirstChild(mmd_t *node)		// I - Node
 {
+  if (node && node->lazy)
+    mmd_parse_lazy(mmd_doc(node), node);
+
   return (node ? node->first_child : NULL);
 }
 
@@ -292,10 +711,27 @@ mmdGetFirstChild(mmd_t *node)		// I - Node
 mmd_t *					// O - Last child or @code NULL@ if none
 mmdGetLastChild(mmd_t *node)		// I - Node
 {
+  if (node && node->lazy)
+    mmd_parse_lazy(mmd_doc(node), node);
+
   return (node ? node->last_child : NULL);
 }
 
 
+//
+// 'mmdGetLimit()' - Get the value of a parse limit.
+//
+
+size_t					// O - Limit value or `0` for unlimited
+mmdGetLimit(mmd_limit_t limit)		// I - Limit
+{
+  if (limit < MMD_LIMIT_BYTES || limit > MMD_LIMIT_INLINE)
+    return (0);
+  else
+    return (mmd_limits[limit]);
+}
+
+
 //
 // 'mmdGetMetadata()' - Return the metadata for the given keyword.
 //
@@ -317,7 +753,7 @@ mmdGetMetadata(mmd_t	  *doc,		// I - Document
   snprintf(prefix, sizeof(prefix), "%s:", keyword);
   prefix_len = strlen(prefix);
 
-  for (current = metadata->first_child; current; current = current->next_sibling)
+  for (current = mmdGetFirstChild(metadata); current; current = current->next_sibling)
   {
     if (strncmp(current->text, prefix, prefix_len))
       continue;
@@ -344,6 +780,52 @@ mmdGetNextSibling(mmd_t *node)		// I - Node
 }
 
 
+//
+// 'mmdGetNodesOfType()' - Get the nodes of a given type in a document.
+//
+// Headings, code blocks, links, images, and check boxes are indexed as they
+// are loaded when the `MMD_OPTION_NODE_INDEX` option is set, so finding them
+// does not require walking the whole document.  The nodes are returned in
+// document order unless blocks were loaded into an earlier part of the
+// document.  The returned array is valid until the document is changed.
+//
+
+mmd_t **				// O - Array of nodes or `NULL` if none
+mmdGetNodesOfType(mmd_t      *doc,	// I - Document root node
+                  mmd_type_t type,	// I - Node type
+                  size_t     *num_nodes)// O - Number of nodes
+{
+  _mmd_doc_t	*d;			// Document
+  _mmd_nodes_t	*nodes;			// Indexed nodes
+
+
+  if (num_nodes)
+    *num_nodes = 0;
+
+  if (!doc || doc->type != MMD_TYPE_DOCUMENT || doc->parent || !num_nodes)
+    return (NULL);
+
+  d = (_mmd_doc_t *)doc;
+
+  if ((nodes = mmd_nodes_find(d, type)) == NULL)
+    return (NULL);
+
+  // Parse any unparsed inline text to index the links, images, and check
+  // boxes in it, putting them back in document order if needed...
+  if (type >= MMD_TYPE_NORMAL_TEXT)
+  {
+    mmdParseInlines(doc);
+
+    if (d->unsorted_nodes)
+      mmd_nodes_rebuild(d);
+  }
+
+  *num_nodes = nodes->num_nodes;
+
+  return (nodes->num_nodes ? nodes->nodes : NULL);
+}
+
+
 //
 // 'mmdGetOptions()' - Get the enabled markdown processing options/extensions.
 //
@@ -355,6 +837,71 @@ mmdGetOptions(void)
 }
 
 
+//
+// 'mmdGetOutline()' - Get the headings of a document.
+//
+// Headings are recorded as they are loaded, so getting the outline does not
+// require walking the document.  The text of each heading is copied the first
+// time it is returned.  The returned array is valid until the document is
+// changed.
+//
+
+const mmd_heading_t *			// O - Array of headings or `NULL` if none
+mmdGetOutline(mmd_t  *doc,		// I - Document root node
+              size_t *num_headings)	// O - Number of headings
+{
+  _mmd_doc_t	*d;			// Document
+  _mmd_nodes_t	*outline;		// Outline headings
+  mmd_heading_t	*heading;		// Current heading
+  char		*text;			// Heading text
+  size_t	i;			// Looping var
+
+
+  if (num_headings)
+    *num_headings = 0;
+
+  if (!doc || doc->type != MMD_TYPE_DOCUMENT || doc->parent || !num_headings)
+    return (NULL);
+
+  d       = (_mmd_doc_t *)doc;
+  outline = d->nodes + MMD_NODES_OUTLINE;
+
+  if (outline->num_nodes > d->alloc_headings)
+  {
+    if ((heading = mmd_realloc(d, d->headings, outline->num_nodes * sizeof(mmd_heading_t))) == NULL)
+      return (NULL);
+
+    d->headings       = heading;
+    d->alloc_headings = outline->num_nodes;
+  }
+
+  // Fill in any headings added or moved since the last call...
+  for (i = d->num_headings, heading = d->headings + i; i < outline->num_nodes; i ++, heading ++)
+  {
+    heading->node  = outline->nodes[i];
+    heading->level = heading->node->type - MMD_TYPE_HEADING_1 + 1;
+
+    mmd_parse_lazy(d, heading->node);
+
+    if ((text = mmdCopyAllText(heading->node)) != NULL)
+    {
+      heading->text = mmd_strndup(d, text, strlen(text));
+      mmd_release(d, text);
+    }
+    else
+      heading->text = NULL;
+
+    if (!heading->text)
+      heading->text = "";
+  }
+
+  d->num_headings = outline->num_nodes;
+  *num_headings   = d->num_headings;
+
+  return (d->num_headings ? d->headings : NULL);
+}
+
+
 //
 // 'mmdGetParent()' - Return the parent of a node, if any.
 //
@@ -377,6 +924,25 @@ mmdGetPrevSibling(mmd_t *node)		// I - Node
 }
 
 
+//
+// 'mmdGetStats()' - Get the parse statistics for a document.
+//
+// The statistics are totals for all of the loads into the document since it
+// was created or last reset with `mmdReset`.  Statistics for documents loaded
+// with `mmdLoadParallel` are totals for all threads, and the block parse time
+// includes any time spent in the block callback.
+//
+
+const mmd_stats_t *			// O - Statistics or `NULL` on error
+mmdGetStats(mmd_t *doc)			// I - Document root node
+{
+  if (!doc || doc->type != MMD_TYPE_DOCUMENT || doc->parent)
+    return (NULL);
+
+  return (&((_mmd_doc_t *)doc)->stats);
+}
+
+
 //
 // 'mmdGetText()' - Return the text associated with a node, if any.
 //
@@ -384,7 +950,18 @@ mmdGetPrevSibling(mmd_t *node)		// I - Node
 const char *				// O - Text or @code NULL@ if none
 mmdGetText(mmd_t *node)			// I - Node
 {
-  return (node ? node->text : NULL);
+  return (node && !node->lazy ? node->text : NULL);
+}
+
+
+//
+// 'mmdGetTextLength()' - Return the length of the text associated with a node.
+//
+
+size_t					// O - Length of text or 0 if none
+mmdGetTextLength(mmd_t *node)		// I - Node
+{
+  return (node && !node->lazy && node->text ? node->textlen : 0);
 }
 
 
@@ -457,87 +1034,271 @@ mmdLoad(mmd_t      *root,		// I - Root node for document or `NULL` for a new doc
 
 
 //
-// 'mmdLoadFile()' - Load a markdown file into nodes from a stdio file.
-//
-
-mmd_t *					// O - First node in markdown
-mmdLoadFile(mmd_t *root,		// I - Root node for document or `NULL` for a new document
-            FILE  *fp)			// I - File to load
-{
-  return (mmdLoadIO(root, (mmd_iocb_t)mmd_iocb_file, fp));
-}
-
-
+// 'mmdLoadBinary()' - Load a document saved with `mmdSave`.
 //
-// 'mmdLoadIO()' - Load a markdown file into nodes using a callback.
+// The buffer is typically a memory-mapped file.  The nodes and strings are
+// copied into the document with a single pass over the buffer, so the buffer
+// can be unmapped or freed after the load.
 //
 
-mmd_t *					// O - First node in markdown
-mmdLoadIO(mmd_t      *root,		// I - Root node for document or `NULL` for a new document
-          mmd_iocb_t cb,		// I - Read callback function
-          void       *cbdata)		// I - Read callback data
+mmd_t *					// O - Root node in markdown
+mmdLoadBinary(mmd_t      *root,		// I - Root node for document or `NULL` for a new document
+              const void *buffer,	// I - Saved document
+              size_t     bytes)		// I - Size of saved document
 {
-  size_t	i;			// Looping var
-  _mmd_doc_t	doc;			// Document
-  _mmd_ref_t	*reference;		// Current reference
-  mmd_t		*block = NULL;		// Current block
-  mmd_type_t	type;			// Type for line
-  _mmd_filebuf_t file;			// File buffer
-  char		line[8192],		// Read line
-		*linestart,		// Start of line
-		*lineptr,		// Pointer into line
-		*lineend,		// End of line
-		*temp;			// Temporary pointer
-  int		newindent;		// New indentation
-  int		blank_code = 0;		// Saved indented blank code line
-  mmd_type_t	columns[256];		// Alignment of table columns
-  int		num_columns = 0,	// Number of columns in table
-		rows = 0;		// Number of rows in table
-  _mmd_stack_t	stack[32],		// Block stack
-		*stackptr = stack;	// Pointer to top of stack
-
+  const unsigned char *data = (const unsigned char *)buffer,
+					// Saved document
+		*record;		// Current node record
+  _mmd_doc_t	*doc;			// Document
+  mmd_t		*last,			// Last node before load
+		*nodes,			// Loaded nodes
+		*top,			// Node for first record
+		*node,			// Current node
+		*parent;		// Parent node
+  char		*pool,			// String pool
+		*poolptr,		// Next string in pool
+		*poolend;		// End of string pool
+  size_t	i,			// Looping var
+		num_nodes,		// Number of nodes
+		pool_size,		// Size of string pool
+		parent_index,		// Index of parent node
+		textlen;		// Length of text
+  int		type,			// Node type
+		flags;			// Node flags
+
+
+  if (!buffer)
+  {
+    errno = EINVAL;
+    return (NULL);
+  }
 
-  // Create an empty document as needed...
-  DEBUG_printf("mmdLoadIO: mmd_options=%d%s%s\n", mmd_options, (mmd_options & MMD_OPTION_METADATA) ? " METADATA" : "", (mmd_options & MMD_OPTION_TABLES) ? " TABLES" : "");
+  if (mmd_limits[MMD_LIMIT_BYTES] && bytes > mmd_limits[MMD_LIMIT_BYTES])
+  {
+    errno = EFBIG;
+    return (NULL);
+  }
 
-  memset(&doc, 0, sizeof(doc));
+  // Validate the header, which is followed by the node records and string
+  // pool...
+  if (bytes < MMD_BINARY_HEADER || memcmp(data, "MMDB", 4) || mmd_binary_get(data + 4) != MMD_BINARY_VERSION)
+  {
+    errno = EINVAL;
+    return (NULL);
+  }
 
-  if (root)
-    doc.root = root;
-  else
-    doc.root = mmd_add(NULL, MMD_TYPE_DOCUMENT, 0, NULL, NULL);
+  num_nodes = mmd_binary_get(data + 8);
+  pool_size = mmd_binary_get(data + 12);
 
-  if (!doc.root)
+  if (num_nodes == 0 || num_nodes > (bytes - MMD_BINARY_HEADER) / MMD_BINARY_RECORD || pool_size != (bytes - MMD_BINARY_HEADER - num_nodes * MMD_BINARY_RECORD) || (pool_size > 0 && data[bytes - 1]))
+  {
+    errno = EINVAL;
     return (NULL);
+  }
 
-  // Initialize the block stack...
-  memset(stack, 0, sizeof(stack));
-  stackptr->parent = doc.root;
+  if (mmd_limits[MMD_LIMIT_NODES] && num_nodes > mmd_limits[MMD_LIMIT_NODES])
+  {
+    errno = EFBIG;
+    return (NULL);
+  }
 
-  // Read lines until end-of-file...
-  memset(&file, 0, sizeof(file));
-  file.cb     = cb;
-  file.cbdata = cbdata;
+  if ((doc = mmd_load_begin(root)) == NULL)
+    return (NULL);
 
-#ifdef __clang_analyzer__
-  memset(line, 0, sizeof(line));
-#endif // __clang_analyzer__
+  last = doc->root->last_child;
 
-  while ((lineptr = mmd_read_line(&file, line, sizeof(line))) != NULL)
-  {
-    DEBUG_printf("%03d	%-12s  %s", stackptr->indent, mmd_type_string(stackptr->parent->type) + 9, lineptr);
-#if DEBUG
-    if (stackptr->parent->type == MMD_TYPE_CODE_BLOCK)
-      DEBUG2_printf("	  blank_code=%d\n", blank_code);
-#endif // DEBUG
+  // Copy the strings and then add the nodes...
+  if ((nodes = mmd_alloc(doc, num_nodes * sizeof(mmd_t))) == NULL || (pool = mmd_alloc(doc, pool_size)) == NULL)
+    return (mmd_load_end(doc, root, last));
 
-    linestart = lineptr;
+  memcpy(pool, data + MMD_BINARY_HEADER + num_nodes * MMD_BINARY_RECORD, pool_size);
+  memset(nodes, 0, num_nodes * sizeof(mmd_t));
 
-    while (isspace(*lineptr & 255))
-      lineptr ++;
+  top     = doc->root;
+  poolptr = pool;
+  poolend = pool + pool_size;
 
-    DEBUG2_printf("	line indent=%d\n", (int)(lineptr - line));
-    DEBUG2_printf("	stackptr=%d\n", (int)(stackptr - stack));
+  for (i = 0, record = data + MMD_BINARY_HEADER; i < num_nodes; i ++, record += MMD_BINARY_RECORD)
+  {
+    type         = record[0];
+    flags        = record[1];
+    parent_index = mmd_binary_get(record + 4);
+    textlen      = mmd_binary_get(record + 8);
+
+    // Only accept trees of known node types...
+    if ((i == 0 && parent_index != MMD_BINARY_NONE) || (i > 0 && parent_index >= i) || (type > MMD_TYPE_TABLE_BODY_CELL_RIGHT && type < MMD_TYPE_NORMAL_TEXT) || type > MMD_TYPE_CHECKBOX || (type == MMD_TYPE_DOCUMENT && i > 0))
+    {
+      DEBUG_printf("mmdLoadBinary: Bad node record %lu.\n", (unsigned long)i);
+      doc->error = EINVAL;
+      break;
+    }
+
+    if (i == 0)
+    {
+      // The first record is the saved document or a node that is added to the
+      // document...
+      if (type == MMD_TYPE_DOCUMENT)
+        continue;
+
+      top    = nodes;
+      parent = doc->root;
+    }
+    else
+    {
+      parent = parent_index ? nodes + parent_index : top;
+    }
+
+    // Inline nodes have no children and are always inside a block...
+    if (parent->type >= MMD_TYPE_NORMAL_TEXT || (type >= MMD_TYPE_NORMAL_TEXT && parent->type == MMD_TYPE_DOCUMENT))
+    {
+      DEBUG_printf("mmdLoadBinary: Bad parent for node record %lu.\n", (unsigned long)i);
+      doc->error = EINVAL;
+      break;
+    }
+
+    node             = nodes + i;
+    node->type       = (mmd_type_t)type;
+    node->whitespace = (flags & MMD_BINARY_WHITESPACE) != 0;
+    node->parent     = parent;
+
+    // The strings follow each other in the pool, and the pool ends with a nul,
+    // so only the text length needs to be checked...
+    if (flags & MMD_BINARY_TEXT)
+    {
+      if (textlen >= (size_t)(poolend - poolptr) || poolptr[textlen])
+      {
+        doc->error = EINVAL;
+        break;
+      }
+
+      node->text    = doc->strings && node->type == MMD_TYPE_METADATA_TEXT ? mmd_intern(doc, poolptr) : poolptr;
+      node->textlen = textlen;
+      poolptr       += textlen + 1;
+    }
+
+    if (flags & MMD_BINARY_URL)
+    {
+      if (poolptr >= poolend)
+      {
+        doc->error = EINVAL;
+        break;
+      }
+
+      node->url = doc->strings ? mmd_intern(doc, poolptr) : poolptr;
+      poolptr   += strlen(poolptr) + 1;
+    }
+
+    if (flags & MMD_BINARY_EXTRA)
+    {
+      if (poolptr >= poolend)
+      {
+        doc->error = EINVAL;
+        break;
+      }
+
+      node->extra = doc->strings && node->type == MMD_TYPE_CODE_BLOCK ? mmd_intern(doc, poolptr) : poolptr;
+      poolptr     += strlen(poolptr) + 1;
+    }
+
+    if (parent->last_child)
+    {
+      parent->last_child->next_sibling = node;
+      node->prev_sibling               = parent->last_child;
+      parent->last_child               = node;
+    }
+    else
+    {
+      parent->first_child = parent->last_child = node;
+    }
+
+    mmd_nodes_add(doc, node);
+
+    doc->num_nodes ++;
+    doc->stats.nodes[type] ++;
+  }
+
+  return (mmd_load_end(doc, root, last));
+}
+
+//
+// 'mmdLoadFile()' - Load a markdown file into nodes from a stdio file.
+//
+
+mmd_t *					// O - First node in markdown
+mmdLoadFile(mmd_t *root,		// I - Root node for document or `NULL` for a new document
+            FILE  *fp)			// I - File to load
+{
+  return (mmdLoadIO(root, (mmd_iocb_t)mmd_iocb_file, fp));
+}
+
+
+//
+// 'mmdLoadIO()' - Load a markdown file into nodes using a callback.
+//
+
+mmd_t *					// O - First node in markdown
+mmdLoadIO(mmd_t      *root,		// I - Root node for document or `NULL` for a new document
+          mmd_iocb_t cb,		// I - Read callback function
+          void       *cbdata)		// I - Read callback data
+{
+  _mmd_doc_t	*doc;			// Document
+  mmd_t		*block = NULL,		// Current block
+		*last;			// Last node before load
+  mmd_type_t	type;			// Type for line
+  _mmd_filebuf_t file;			// File buffer
+  char		line[8192],		// Read line
+		*linestart,		// Start of line
+		*lineptr,		// Pointer into line
+		*lineend,		// End of line
+		*temp;			// Temporary pointer
+  int		newindent;		// New indentation
+  int		blank_code = 0;		// Saved indented blank code line
+  mmd_type_t	columns[256];		// Alignment of table columns
+  int		num_columns = 0,	// Number of columns in table
+		rows = 0;		// Number of rows in table
+  _mmd_stack_t	stack[32],		// Block stack
+		*stackptr = stack;	// Pointer to top of stack
+  double	start,			// Start time
+		inline_time;		// Inline parse time before load
+
+
+  DEBUG_printf("mmdLoadIO: mmd_options=%d%s%s\n", mmd_options, (mmd_options & MMD_OPTION_METADATA) ? " METADATA" : "", (mmd_options & MMD_OPTION_TABLES) ? " TABLES" : "");
+
+  if ((doc = mmd_load_begin(root)) == NULL)
+    return (NULL);
+
+  last        = doc->root->last_child;
+  start       = mmd_time();
+  inline_time = doc->stats.inline_time;
+
+  // Initialize the block stack...
+  memset(stack, 0, sizeof(stack));
+  stackptr->parent = doc->root;
+
+  // Read lines until end-of-file...
+  memset(&file, 0, sizeof(file));
+  file.cb     = cb;
+  file.cbdata = cbdata;
+
+#ifdef __clang_analyzer__
+  memset(line, 0, sizeof(line));
+#endif // __clang_analyzer__
+
+  while (!doc->error && (lineptr = mmd_read_line(&file, line, sizeof(line))) != NULL)
+  {
+    DEBUG_printf("%03d	%-12s  %s", stackptr->indent, mmd_type_string(stackptr->parent->type) + 9, lineptr);
+#if DEBUG
+    if (stackptr->parent->type == MMD_TYPE_CODE_BLOCK)
+      DEBUG2_printf("	  blank_code=%d\n", blank_code);
+#endif // DEBUG
+
+    linestart = lineptr;
+
+    while (isspace(*lineptr & 255))
+      lineptr ++;
+
+    DEBUG2_printf("	line indent=%d\n", (int)(lineptr - line));
+    DEBUG2_printf("	stackptr=%d\n", (int)(stackptr - stack));
 
     if (!*lineptr && stackptr->parent->type == MMD_TYPE_TABLE)
     {
@@ -555,9 +1316,12 @@ mmdLoadIO(mmd_t      *root,		// I - Root node for document or `NULL` for a new d
       {
 	block		 = NULL;
 	stackptr	 = stack + 1;
-	stackptr->parent = mmd_add(doc.root, MMD_TYPE_BLOCK_QUOTE, 0, NULL, NULL);
+	stackptr->parent = mmd_add(doc, doc->root, MMD_TYPE_BLOCK_QUOTE, 0, NULL, NULL);
 	stackptr->indent = 2;
 	stackptr->fence	 = '\0';
+
+	if (doc->error)
+	  break;
       }
 
       // Skip whitespace after the ">"...
@@ -602,16 +1366,19 @@ mmdLoadIO(mmd_t      *root,		// I - Root node for document or `NULL` for a new d
 	DEBUG2_printf("Starting code block with fence '%c'.\n", *lineptr);
 
 	block		     = NULL;
-	stackptr[1].parent   = mmd_add(stackptr->parent, MMD_TYPE_CODE_BLOCK, 0, NULL, NULL);
+	stackptr[1].parent   = mmd_add(doc, stackptr->parent, MMD_TYPE_CODE_BLOCK, 0, NULL, NULL);
 	stackptr[1].indent   = lineptr - line;
 	stackptr[1].fence    = *lineptr;
 	stackptr[1].fencelen = mmd_is_codefence(lineptr, '\0', 0, &language);
 	stackptr ++;
 
+	if (doc->error)
+	  break;
+
 	DEBUG2_printf("Code language=\"%s\"\n", language);
 
 	if (language)
-	  stackptr->parent->extra = strdup(language);
+	  stackptr->parent->extra = mmd_intern(doc, language);
 
 	blank_code = 0;
       }
@@ -627,11 +1394,11 @@ mmdLoadIO(mmd_t      *root,		// I - Root node for document or `NULL` for a new d
       {
 	while (blank_code > 0)
 	{
-	  mmd_add(stackptr->parent, MMD_TYPE_CODE_TEXT, 0, "\n", NULL);
+	  mmd_add_code(doc, stackptr->parent, "\n");
 	  blank_code --;
 	}
 
-	mmd_add(stackptr->parent, MMD_TYPE_CODE_TEXT, 0, line + stackptr->indent, NULL);
+	mmd_add_code(doc, stackptr->parent, line + stackptr->indent);
       }
       continue;
     }
@@ -647,33 +1414,39 @@ mmdLoadIO(mmd_t      *root,		// I - Root node for document or `NULL` for a new d
       {
 	while (blank_code > 0)
 	{
-	  mmd_add(stackptr->parent, MMD_TYPE_CODE_TEXT, 0, "\n", NULL);
+	  mmd_add_code(doc, stackptr->parent, "\n");
 	  blank_code --;
 	}
 
-	mmd_add(stackptr->parent, MMD_TYPE_CODE_TEXT, 0, lineptr, NULL);
+	mmd_add_code(doc, stackptr->parent, lineptr);
       }
       continue;
     }
-    else if (!strncmp(lineptr, "---", 3) && doc.root->first_child == NULL && (mmd_options & MMD_OPTION_METADATA))
+    else if (!strncmp(lineptr, "---", 3) && doc->root->first_child == NULL && !doc->block_freed && (mmd_options & MMD_OPTION_METADATA) && !doc->no_metadata)
     {
       // Document metadata...
-      block = mmd_add(doc.root, MMD_TYPE_METADATA, 0, NULL, NULL);
+      block	       = mmd_add(doc, doc->root, MMD_TYPE_METADATA, 0, NULL, NULL);
+      doc->in_metadata = true;
 
-      while ((lineptr = mmd_read_line(&file, line, sizeof(line))) != NULL)
+      while (!doc->error && (lineptr = mmd_read_line(&file, line, sizeof(line))) != NULL)
       {
 	while (isspace(*lineptr & 255))
 	  lineptr ++;
 
 	if (!strncmp(lineptr, "---", 3) || !strncmp(lineptr, "...", 3))
+	{
+	  doc->in_metadata = false;
 	  break;
+	}
 
 	lineend = lineptr + strlen(lineptr) - 1;
 	if (lineend > lineptr && *lineend == '\n')
 	  *lineend = '\0';
 
-	mmd_add(block, MMD_TYPE_METADATA_TEXT, 0, lineptr, NULL);
+	mmd_add(doc, block, MMD_TYPE_METADATA_TEXT, 0, lineptr, NULL);
       }
+
+      block = NULL;
       continue;
     }
     else if (block && block->type == MMD_TYPE_PARAGRAPH && (lineptr - linestart) < 4 && (lineptr - line) >= stackptr->indent && (mmd_is_chars(lineptr, "-", 1) || mmd_is_chars(lineptr, "=", 1)))
@@ -695,6 +1468,11 @@ mmdLoadIO(mmd_t      *root,		// I - Root node for document or `NULL` for a new d
 	else
 	  block->type = MMD_TYPE_HEADING_2;
 
+	doc->stats.nodes[MMD_TYPE_PARAGRAPH] --;
+	doc->stats.nodes[block->type] ++;
+
+	mmd_nodes_add(doc, block);
+
 	block = NULL;
 	continue;
       }
@@ -710,7 +1488,7 @@ mmdLoadIO(mmd_t      *root,		// I - Root node for document or `NULL` for a new d
       else
 	stackptr = stack;
 
-      mmd_add(stackptr->parent, MMD_TYPE_THEMATIC_BREAK, 0, NULL, NULL);
+      mmd_add(doc, stackptr->parent, MMD_TYPE_THEMATIC_BREAK, 0, NULL, NULL);
 //      type  = MMD_TYPE_PARAGRAPH;
       block = NULL;
       continue;
@@ -741,7 +1519,7 @@ mmdLoadIO(mmd_t      *root,		// I - Root node for document or `NULL` for a new d
 
       if (stackptr->parent->type != MMD_TYPE_UNORDERED_LIST && stackptr < (stack + sizeof(stack) / sizeof(stack[0]) - 1))
       {
-	stackptr[1].parent = mmd_add(stackptr->parent, MMD_TYPE_UNORDERED_LIST, 0, NULL, NULL);
+	stackptr[1].parent = mmd_add(doc, stackptr->parent, MMD_TYPE_UNORDERED_LIST, 0, NULL, NULL);
 	stackptr[1].indent = linestart - line;
 	stackptr[1].fence  = '\0';
 	stackptr ++;
@@ -749,18 +1527,21 @@ mmdLoadIO(mmd_t      *root,		// I - Root node for document or `NULL` for a new d
 
       if (stackptr < (stack + sizeof(stack) / sizeof(stack[0]) - 1))
       {
-	stackptr[1].parent = mmd_add(stackptr->parent, MMD_TYPE_LIST_ITEM, 0, NULL, NULL);
+	stackptr[1].parent = mmd_add(doc, stackptr->parent, MMD_TYPE_LIST_ITEM, 0, NULL, NULL);
 	stackptr[1].indent = linestart - line;
 	stackptr[1].fence  = '\0';
 	stackptr ++;
       }
 
+      if (doc->error)
+	break;
+
       type  = MMD_TYPE_PARAGRAPH;
       block = NULL;
 
       if (mmd_is_chars(lineptr, "- \t", 3) || mmd_is_chars(lineptr, "_ \t", 3) || mmd_is_chars(lineptr, "* \t", 3))
       {
-	mmd_add(stackptr->parent, MMD_TYPE_THEMATIC_BREAK, 0, NULL, NULL);
+	mmd_add(doc, stackptr->parent, MMD_TYPE_THEMATIC_BREAK, 0, NULL, NULL);
 	continue;
       }
     }
@@ -798,7 +1579,7 @@ mmdLoadIO(mmd_t      *root,		// I - Root node for document or `NULL` for a new d
 
 	if (stackptr->parent->type != MMD_TYPE_ORDERED_LIST && stackptr < (stack + sizeof(stack) / sizeof(stack[0]) - 1))
 	{
-	  stackptr[1].parent = mmd_add(stackptr->parent, MMD_TYPE_ORDERED_LIST, 0, NULL, NULL);
+	  stackptr[1].parent = mmd_add(doc, stackptr->parent, MMD_TYPE_ORDERED_LIST, 0, NULL, NULL);
 	  stackptr[1].indent = linestart - line;
 	  stackptr[1].fence  = '\0';
 	  stackptr ++;
@@ -806,12 +1587,15 @@ mmdLoadIO(mmd_t      *root,		// I - Root node for document or `NULL` for a new d
 
 	if (stackptr < (stack + sizeof(stack) / sizeof(stack[0]) - 1))
 	{
-	  stackptr[1].parent = mmd_add(stackptr->parent, MMD_TYPE_LIST_ITEM, 0, NULL, NULL);
+	  stackptr[1].parent = mmd_add(doc, stackptr->parent, MMD_TYPE_LIST_ITEM, 0, NULL, NULL);
 	  stackptr[1].indent = linestart - line;
 	  stackptr[1].fence  = '\0';
 	  stackptr ++;
 	}
 
+	if (doc->error)
+	  break;
+
 	type  = MMD_TYPE_PARAGRAPH;
 	block = NULL;
       }
@@ -862,7 +1646,8 @@ mmdLoadIO(mmd_t      *root,		// I - Root node for document or `NULL` for a new d
 	while (stackptr > stack && stackptr->indent > newindent)
 	  stackptr --;
 
-	block = mmd_add(stackptr->parent, type, 0, NULL, NULL);
+	if ((block = mmd_add(doc, stackptr->parent, type, 0, NULL, NULL)) == NULL)
+	  break;
       }
       else
       {
@@ -902,9 +1687,9 @@ mmdLoadIO(mmd_t      *root,		// I - Root node for document or `NULL` for a new d
       if (block)
       {
 	if (block->type == MMD_TYPE_LIST_ITEM)
-	  block = mmd_add(block, MMD_TYPE_PARAGRAPH, 0, NULL, NULL);
+	  block = mmd_add(doc, block, MMD_TYPE_PARAGRAPH, 0, NULL, NULL);
 	else if (block->parent->type == MMD_TYPE_LIST_ITEM)
-	  block = mmd_add(block->parent, MMD_TYPE_PARAGRAPH, 0, NULL, NULL);
+	  block = mmd_add(doc, block->parent, MMD_TYPE_PARAGRAPH, 0, NULL, NULL);
 	else
 	  block = NULL;
       }
@@ -925,12 +1710,12 @@ mmdLoadIO(mmd_t      *root,		// I - Root node for document or `NULL` for a new d
       {
 	DEBUG2_printf("ADDING NEW TABLE to %p (%s)\n", stackptr->parent, mmd_type_string(stackptr->parent->type));
 
-	stackptr[1].parent = mmd_add(stackptr->parent, MMD_TYPE_TABLE, 0, NULL, NULL);
+	stackptr[1].parent = mmd_add(doc, stackptr->parent, MMD_TYPE_TABLE, 0, NULL, NULL);
 	stackptr[1].indent = stackptr->indent;
 	stackptr[1].fence  = '\0';
 	stackptr ++;
 
-	block = mmd_add(stackptr->parent, MMD_TYPE_TABLE_HEADER, 0, NULL, NULL);
+	block = mmd_add(doc, stackptr->parent, MMD_TYPE_TABLE_HEADER, 0, NULL, NULL);
 
 	for (col = 0; col < (int)(sizeof(columns) / sizeof(columns[0])); col ++)
 	  columns[col] = MMD_TYPE_TABLE_BODY_CELL_LEFT;
@@ -941,13 +1726,13 @@ mmdLoadIO(mmd_t      *root,		// I - Root node for document or `NULL` for a new d
       else if (rows > 0)
       {
 	if (rows == 1)
-	  block = mmd_add(stackptr->parent, MMD_TYPE_TABLE_BODY, 0, NULL, NULL);
+	  block = mmd_add(doc, stackptr->parent, MMD_TYPE_TABLE_BODY, 0, NULL, NULL);
       }
       else
 	block = NULL;
 
       if (block)
-	row = mmd_add(block, MMD_TYPE_TABLE_ROW, 0, NULL, NULL);
+	row = mmd_add(doc, block, MMD_TYPE_TABLE_ROW, 0, NULL, NULL);
 
       if (*lineptr == '|')
 	lineptr ++;			// Skip leading pipe
@@ -972,11 +1757,11 @@ mmdLoadIO(mmd_t      *root,		// I - Root node for document or `NULL` for a new d
 	{
 	  // Add a cell to this row...
 	  if (block->type == MMD_TYPE_TABLE_HEADER)
-	    cell = mmd_add(row, MMD_TYPE_TABLE_HEADER_CELL, 0, NULL, NULL);
+	    cell = mmd_add(doc, row, MMD_TYPE_TABLE_HEADER_CELL, 0, NULL, NULL);
 	  else
-	    cell = mmd_add(row, columns[col], 0, NULL, NULL);
+	    cell = mmd_add(doc, row, columns[col], 0, NULL, NULL);
 
-	  mmd_parse_inline(&doc, cell, start);
+	  mmd_add_inline(doc, cell, start);
 	}
 	else
 	{
@@ -1005,7 +1790,7 @@ mmdLoadIO(mmd_t      *root,		// I - Root node for document or `NULL` for a new d
       {
 	while (col < num_columns)
 	{
-	  mmd_add(row, columns[col], 0, NULL, NULL);
+	  mmd_add(doc, row, columns[col], 0, NULL, NULL);
 	  col ++;
 	}
       }
@@ -1025,7 +1810,7 @@ mmdLoadIO(mmd_t      *root,		// I - Root node for document or `NULL` for a new d
       // Indented code block.
       if (stackptr->parent->type != MMD_TYPE_CODE_BLOCK && stackptr < (stack + sizeof(stack) / sizeof(stack[0]) - 1))
       {
-	stackptr[1].parent = mmd_add(stackptr->parent, MMD_TYPE_CODE_BLOCK, 0, NULL, NULL);
+	stackptr[1].parent = mmd_add(doc, stackptr->parent, MMD_TYPE_CODE_BLOCK, 0, NULL, NULL);
 	stackptr[1].indent = stackptr->indent + 4;
 	stackptr[1].fence  = '\0';
 	stackptr ++;
@@ -1035,11 +1820,11 @@ mmdLoadIO(mmd_t      *root,		// I - Root node for document or `NULL` for a new d
 
       while (blank_code > 0)
       {
-	mmd_add(stackptr->parent, MMD_TYPE_CODE_TEXT, 0, "\n", NULL);
+	mmd_add_code(doc, stackptr->parent, "\n");
 	blank_code --;
       }
 
-      mmd_add(stackptr->parent, MMD_TYPE_CODE_TEXT, 0, line + stackptr->indent, NULL);
+      mmd_add_code(doc, stackptr->parent, line + stackptr->indent);
 
       continue;
     }
@@ -1049,1256 +1834,4223 @@ mmdLoadIO(mmd_t      *root,		// I - Root node for document or `NULL` for a new d
       if (stackptr->parent->type == MMD_TYPE_CODE_BLOCK)
 	stackptr --;
 
-      block = mmd_add(stackptr->parent, type, 0, NULL, NULL);
+      if ((block = mmd_add(doc, stackptr->parent, type, 0, NULL, NULL)) == NULL)
+	break;
     }
 
-    // Read continuation lines before parsing this...
-    while (mmd_has_continuation(line, &file, stackptr->indent))
+    // Read continuation lines before parsing this, keeping track of the end of
+    // the line so that long paragraphs aren't rescanned for each line...
+    for (lineend = line + strlen(line); mmd_has_continuation(line, &file, stackptr->indent); lineend += strlen(lineend))
     {
-      char *ptr = line + strlen(line);
-
-      if (!mmd_read_line(&file, ptr, sizeof(line) - (size_t)(ptr - line)))
+      if (!mmd_read_line(&file, lineend, sizeof(line) - (size_t)(lineend - line)))
 	break;
-      else if (line[0] == '>' && *ptr == '>')
-	memmove(ptr, ptr + 1, strlen(ptr));
+      else if (line[0] == '>' && *lineend == '>')
+	memmove(lineend, lineend + 1, strlen(lineend));
+
+      doc->stats.continuations ++;
 
       DEBUG2_printf("        line=\"%s\"\n", line);
     }
 
-    mmd_parse_inline(&doc, block, lineptr);
+    mmd_add_inline(doc, block, lineptr);
 
-    if (block->type == MMD_TYPE_PARAGRAPH && !block->first_child)
+    if (block->type == MMD_TYPE_PARAGRAPH && !block->first_child && !block->lazy)
     {
       mmd_remove(block);
-      mmd_free(block);
-      block = NULL;
-    }
-  }
-
-  // Free any references...
-  for (i = doc.num_references, reference = doc.references; i > 0; i --, reference ++)
-  {
-    if (reference->pending)
-    {
-      char	text[8192];		// Reference text
-      size_t	j;			// Looping var
+      mmd_free_nodes(doc, block);
 
-      DEBUG2_printf("Clearing links for '%s'.\n", reference->name);
-      snprintf(text, sizeof(text), "[%s]", reference->name);
-
-      for (j = 0; j < reference->num_pending; j ++)
+      if (doc->cur_held && doc->held[doc->cur_held - 1].block == block)
       {
-	free(reference->pending[j]->text);
-	reference->pending[j]->text = strdup(text);
-	reference->pending[j]->type = MMD_TYPE_NORMAL_TEXT;
+        // Reuse the memory for an empty top-level paragraph...
+        if (block == doc->block_next)
+          doc->block_next = NULL;
+
+	mmd_block_chunks(doc, doc->cur_held, false);
       }
 
-      free(reference->pending);
+      block = NULL;
     }
-
-    free(reference->name);
-    free(reference->url);
   }
 
-  free(doc.references);
+  // Remember whether the load ended in the middle of a code fence...
+  doc->in_fence = stackptr->fence != '\0';
 
-  // Return the root node...
-  return (doc.root);
-}
+  if (file.overflow)
+    doc->error = EFBIG;
 
+  // Update the statistics, counting everything but inline parsing as block
+  // parsing...
+  doc->stats.bytes      += file.bytes;
+  doc->stats.lines      += file.lines;
+  doc->stats.refills    += file.refills;
+  doc->stats.block_time += mmd_time() - start - (doc->stats.inline_time - inline_time);
 
-//
-// 'mmdLoadString()' - Load a markdown string into nodes.
-//
-
-mmd_t *					// O - Root node in markdown
-mmdLoadString(mmd_t      *root,		// I - Root node for document or `NULL` for a new document
-              const char *s)		// I - String to load
-{
-  return (mmdLoadIO(root, (mmd_iocb_t)mmd_iocb_string, &s));
+  return (mmd_load_end(doc, root, last));
 }
 
 
 //
-// 'mmdSetOptions()' - Set (enable/disable) support for various markdown options.
+// 'mmdLoadMetadata()' - Load the metadata of a markdown file.
+//
+// Only the metadata at the start of the file is read, so this is much faster
+// than loading the whole file when only the metadata is needed.  The returned
+// root node has a single `MMD_TYPE_METADATA` child node, or no children if the
+// file does not start with metadata or the `MMD_OPTION_METADATA` option is not
+// set.  Metadata is only loaded into a root node without any children.
 //
 
-void
-mmdSetOptions(mmd_option_t options)	// I - Options
+mmd_t *					// O - Root node in markdown
+mmdLoadMetadata(mmd_t      *root,	// I - Root node for document or `NULL` for a new document
+                const char *filename)	// I - File to load
 {
-  mmd_options = options;
-}
-
+  _mmd_doc_t	*doc;			// Document
+  FILE		*fp;			// File
+  mmd_t		*block = NULL,		// Metadata block
+		*last;			// Last node before load
+  _mmd_filebuf_t file;			// File buffer
+  char		line[8192],		// Read line
+		*lineptr,		// Pointer into line
+		*lineend;		// End of line
+  double	start;			// Start time
 
-//
-// 'mmd_add()' - Add a new markdown node.
-//
 
-static mmd_t *				// O - New node
-mmd_add(mmd_t	   *parent,		// I - Parent node
-	mmd_type_t type,		// I - Node type
-	int	   whitespace,		// I - 1 if whitespace precedes this node
-	char	   *text,		// I - Text, if any
-	char	   *url)		// I - URL, if any
-{
-  mmd_t		*temp;			// New node
+  // Open the file...
+  if ((fp = fopen(filename, "r")) == NULL)
+    return (NULL);
 
+  if ((doc = mmd_load_begin(root)) == NULL)
+  {
+    fclose(fp);
+    return (NULL);
+  }
 
-  DEBUG2_printf("Adding %s to %p(%s), whitespace=%d, text=\"%s\", url=\"%s\"\n", mmd_type_string(type), parent, parent ? mmd_type_string(parent->type) : "", whitespace, text ? text : "(null)", url ? url : "(null)");
+  last  = doc->root->last_child;
+  start = mmd_time();
 
-  if (!parent && type != MMD_TYPE_DOCUMENT)
-    return (NULL);			// Only document nodes can be at the root
+  // Read one line at a time so nothing after the metadata is read...
+  memset(&file, 0, sizeof(file));
+  file.cb     = (mmd_iocb_t)mmd_iocb_line;
+  file.cbdata = fp;
 
-  if ((temp = calloc(1, sizeof(mmd_t))) != NULL)
+  while (!doc->error && (lineptr = mmd_read_line(&file, line, sizeof(line))) != NULL)
   {
-    if (parent)
+    while (isspace(*lineptr & 255))
+      lineptr ++;
+
+    if (!block)
     {
-      // Add node to the parent...
-      temp->parent = parent;
+      // The metadata must start the document, after any blank lines...
+      if (!*lineptr)
+        continue;
+      else if (strncmp(lineptr, "---", 3) || doc->root->first_child || !(mmd_options & MMD_OPTION_METADATA))
+        break;
 
-      if (parent->last_child)
-      {
-	parent->last_child->next_sibling = temp;
-	temp->prev_sibling		 = parent->last_child;
-	parent->last_child		 = temp;
-      }
-      else
-      {
-	parent->first_child = parent->last_child = temp;
-      }
+      block = mmd_add(doc, doc->root, MMD_TYPE_METADATA, 0, NULL, NULL);
+      continue;
     }
 
-    // Copy the node values...
-    temp->type	     = type;
-    temp->whitespace = whitespace;
+    if (!strncmp(lineptr, "---", 3) || !strncmp(lineptr, "...", 3))
+      break;
 
-    if (text)
-      temp->text = strdup(text);
+    lineend = lineptr + strlen(lineptr) - 1;
+    if (lineend > lineptr && *lineend == '\n')
+      *lineend = '\0';
 
-    if (url)
-      temp->url = strdup(url);
+    mmd_add(doc, block, MMD_TYPE_METADATA_TEXT, 0, lineptr, NULL);
   }
 
-  return (temp);
-}
+  fclose(fp);
 
+  if (file.overflow)
+    doc->error = EFBIG;
 
-//
-// 'mmd_free()' - Free memory used by a node.
-//
+  doc->stats.bytes      += file.bytes;
+  doc->stats.lines      += file.lines;
+  doc->stats.refills    += file.refills;
+  doc->stats.block_time += mmd_time() - start;
 
-static void
-mmd_free(mmd_t *node)			// I - Node
-{
-  free(node->text);
-  free(node->url);
-  free(node->extra);
-  free(node);
+  return (mmd_load_end(doc, root, last));
 }
 
 
 //
-// 'mmd_has_continuation()' - Determine whether the next line is a continuation
-//			      of the current one.
+// 'mmdLoadParallel()' - Load a markdown buffer into nodes using multiple threads.
+//
+// The buffer is split into parts at blank lines between top-level paragraphs
+// and the parts are loaded concurrently, then joined and their references
+// resolved as if the buffer had been loaded with `mmdLoadString`.
+//
+// The "num_threads" argument specifies the maximum number of threads to use,
+// with 0 meaning one thread per processor.  Small buffers are loaded using the
+// calling thread.
 //
 
-static int				// O - 1 if the next line continues, 0 otherwise
-mmd_has_continuation(
-    const char	   *line,		// I - Current line
-    _mmd_filebuf_t *file,		// I - File buffer
-    int		   indent)		// I - Indentation for current block
+mmd_t *					// O - Root node in markdown
+mmdLoadParallel(mmd_t      *root,	// I - Root node for document or `NULL` for a new document
+                const char *buffer,	// I - Buffer to load
+                size_t     bytes,	// I - Number of bytes in buffer
+                int        num_threads)	// I - Maximum number of threads or 0 for automatic
 {
-  const char	*lineptr = line;	// Pointer into current line
-  const char	*fileptr = file->bufptr;// Pointer into next line
-
+  _mmd_doc_t	*doc;			// Document
+  mmd_t		*last;			// Last node before load
+  _mmd_part_t	*parts,			// Parts to load
+		*part,			// Current part
+		*current;		// Part being joined
+  size_t	i,			// Looping var
+		max_parts,		// Maximum number of parts
+		num_parts;		// Number of parts
+  bool		empty,			// Metadata still possible?
+		reloaded;		// Was the current part reloaded?
+  _mmd_membuf_t	buf;			// Buffer for serial loads
+
+
+  if (!buffer)
+  {
+    errno = EINVAL;
+    return (NULL);
+  }
 
-  if (*fileptr == '\n' || *fileptr == '\r')
-    return (0);
+  if (mmd_limits[MMD_LIMIT_BYTES] && bytes > mmd_limits[MMD_LIMIT_BYTES])
+  {
+    errno = EFBIG;
+    return (NULL);
+  }
 
-  do
+  // Figure out how many parts to use...
+  if (num_threads <= 0)
   {
-    while (isspace(*lineptr & 255))
-      lineptr ++;
+#if _WIN32
+    SYSTEM_INFO	info;			// System information
 
-    if (*lineptr == '[' && (lineptr - line - indent) < 4 && (*fileptr == ' ' || *fileptr == '\t'))
-      return (1);
+    GetSystemInfo(&info);
+    num_threads = (int)info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    num_threads = 1;
+#endif // _WIN32
+  }
 
-    while (isspace(*fileptr & 255))
-      fileptr ++;
+  if ((max_parts = bytes / MMD_PARALLEL_MIN) > (size_t)num_threads)
+    max_parts = (size_t)num_threads;
 
-    if (*lineptr == '>' && *fileptr == '>')
-    {
-      lineptr ++;
-      fileptr ++;
-    }
-    else if (*fileptr == '>')
-      return (0);
+  DEBUG_printf("mmdLoadParallel: bytes=%lu, num_threads=%d, max_parts=%lu\n", (unsigned long)bytes, num_threads, (unsigned long)max_parts);
 
-    if (*fileptr == '\n' || *fileptr == '\r')
-      return (0);
+  if (max_parts > 1 && (parts = mmd_realloc(NULL, NULL, max_parts * sizeof(_mmd_part_t))) != NULL)
+  {
+    memset(parts, 0, max_parts * sizeof(_mmd_part_t));
+    num_parts = mmd_parallel_split(buffer, bytes, max_parts, parts, (mmd_options & MMD_OPTION_METADATA) && (!root || !root->first_child));
   }
-  while (isspace(*lineptr & 255) || isspace(*fileptr & 255));
-
-  if (*lineptr == '#')
-    return (0);
-
-  if (strchr("-+*", *fileptr) && isspace(fileptr[1] & 255))
+  else
   {
-    // Bullet list item...
-    return (0);
+    parts     = NULL;
+    num_parts = 1;
   }
 
-  if (isdigit(*fileptr & 255))
+  if (num_parts < 2)
   {
-    // Ordered list item...
-    while (*fileptr && isdigit(*fileptr & 255))
-      fileptr ++;
+    // Load the buffer using the current thread...
+    mmd_release(NULL, parts);
 
-    if (*fileptr == '.' || *fileptr == '(')
-      return (0);
+    buf.ptr = buffer;
+    buf.end = buffer + bytes;
+
+    return (mmdLoadIO(root, (mmd_iocb_t)mmd_iocb_buffer, &buf));
   }
 
-  if (mmd_is_codefence((char *)fileptr, '\0', 0, NULL))
-    return (0);
+  if ((doc = mmd_load_begin(root)) == NULL)
+  {
+    mmd_release(NULL, parts);
+    return (NULL);
+  }
 
-  if (mmd_is_chars(fileptr, "- \t", 3) || mmd_is_chars(fileptr, "_ \t", 3) || mmd_is_chars(fileptr, "* \t", 3))
+  last  = doc->root->last_child;
+  empty = (mmd_options & MMD_OPTION_METADATA) && !doc->root->first_child;
+
+  // Load the parts, the first one using the current thread...
+  for (i = 0, part = parts; i < num_parts; i ++, part ++)
   {
-    // Thematic break...
-    return (0);
+    part->parent      = doc;
+    part->no_metadata = i > 0 || !empty;
+
+    if (i == 0)
+      continue;
+
+#if _WIN32
+    part->started = (part->thread = CreateThread(NULL, 0, mmd_parallel_thread, part, 0, NULL)) != NULL;
+#else
+    part->started = !pthread_create(&part->thread, NULL, mmd_parallel_thread, part);
+#endif // _WIN32
+
+    if (!part->started)
+      mmd_parallel_load(part);
   }
 
-  if (mmd_is_chars(fileptr, "-", 1) || mmd_is_chars(fileptr, "=", 1))
+  mmd_parallel_load(parts);
+
+  for (i = 1, part = parts + 1; i < num_parts; i ++, part ++)
   {
-    // Heading...
-    return (0);
+    if (!part->started)
+      continue;
+
+#if _WIN32
+    WaitForSingleObject(part->thread, INFINITE);
+    CloseHandle(part->thread);
+#else
+    pthread_join(part->thread, NULL);
+#endif // _WIN32
   }
 
-  if (*fileptr == '#')
+  // Join the parts in order.  A part that ended inside a code fence or metadata
+  // was not split at a safe place, so it gets loaded again along with the
+  // following part.  If that still isn't enough (say for a fence that is never
+  // closed), the rest of the buffer is loaded at once rather than reloading it
+  // for every later part...
+  for (i = 1, current = parts, reloaded = false; i <= num_parts && !doc->error; i ++)
   {
-    // Possible heading...
-    int count = 0;
+    part = i < num_parts ? parts + i : NULL;
 
-    while (*fileptr == '#')
+    if (!current->doc)
     {
-      fileptr ++;
-      count ++;
+      doc->error = ENOMEM;
+      break;
     }
+    else if (current->doc->error)
+    {
+      doc->error = current->doc->error;
+      break;
+    }
+    else if (part && (current->doc->in_fence || current->doc->in_metadata || (empty && !current->doc->node.first_child)))
+    {
+      DEBUG_printf("mmdLoadParallel: Reloading parts %lu and %lu.\n", (unsigned long)(current - parts), (unsigned long)i);
 
-    if (count <= 6)
-      return (0);
+      mmd_free(&current->doc->node);
+      current->doc = NULL;
+
+      if (reloaded)
+      {
+        for (; i < (num_parts - 1); i ++, part ++)
+        {
+          if (part->doc)
+          {
+            mmd_free(&part->doc->node);
+            part->doc = NULL;
+          }
+        }
+      }
+
+      if (part->doc)
+      {
+        mmd_free(&part->doc->node);
+        part->doc = NULL;
+      }
+
+      part->start       = current->start;
+      part->no_metadata = current->no_metadata;
+      reloaded          = true;
+
+      mmd_parallel_load(part);
+    }
+    else
+    {
+      if (current->doc->node.first_child)
+        empty = false;
+
+      reloaded = false;
+
+      mmd_parallel_merge(doc, current->doc);
+      current->doc = NULL;
+    }
+
+    current = part;
   }
 
-  return ((fileptr - file->bufptr) <= indent);
+  // Free any parts that were not joined...
+  for (i = 0, part = parts; i < num_parts; i ++, part ++)
+  {
+    if (part->doc)
+      mmd_free(&part->doc->node);
+  }
+
+  mmd_release(NULL, parts);
+
+  return (mmd_load_end(doc, root, last));
 }
 
 
 //
-// 'mmd_iocb_file()' - Read from a file.
+// 'mmdLoadString()' - Load a markdown string into nodes.
 //
 
-static size_t				// O - Number of bytes read
-mmd_iocb_file(FILE   *fp,		// I - File pointer
-              char   *buffer,		// I - Buffer
-              size_t bytes)		// I - Number of bytes to read
+mmd_t *					// O - Root node in markdown
+mmdLoadString(mmd_t      *root,		// I - Root node for document or `NULL` for a new document
+              const char *s)		// I - String to load
 {
-  return (fread(buffer, 1, bytes, fp));
+  _mmd_membuf_t	buf;			// Memory buffer
+
+
+  if (!s)
+  {
+    errno = EINVAL;
+    return (NULL);
+  }
+
+  buf.ptr = s;
+  buf.end = s + strlen(s);
+
+  return (mmdLoadIO(root, (mmd_iocb_t)mmd_iocb_buffer, &buf));
 }
 
 
 //
-// 'mmd_iocb_string()' - Read from a string.
+// 'mmdNew()' - Create an empty document.
+//
+// The document uses the specified allocator for all of its memory, including
+// strings returned by `mmdCopyAllText`.  The function is called with the
+// callback data, a pointer to the memory to reallocate or `NULL` to allocate
+// new memory, and the number of bytes to allocate or `0` to free the memory,
+// like `realloc` and `free`.  It returns the allocated memory or `NULL` when
+// freeing memory or when it cannot allocate the memory, in which case the load
+// fails with `ENOMEM`.
+//
+// Load into the document by passing it as the root node of the load functions.
+// Documents created by passing a `NULL` root node to the load functions use the
+// standard C library functions, as does passing `NULL` for the allocator.  The
+// function must be thread-safe when used with `mmdLoadParallel`.
 //
 
-static size_t				// O - Number of bytes read
-mmd_iocb_string(const char **s,		// I - Pointer into string
-                char       *buffer,	// I - Buffer
-                size_t     bytes)	// I - Number of bytes to read
+mmd_t *					// O - Document or `NULL` on error
+mmdNew(mmd_alloc_cb_t cb,		// I - Allocator function or `NULL` for the default
+       void           *cbdata)		// I - Allocator data
 {
-  size_t	ret;			// Bytes read/returned
+  _mmd_doc_t	*doc;			// Document
 
 
-  // See how many bytes remain in the string...
-  if ((ret = strlen(*s)) > bytes)
-    ret = bytes;
+  if (cb)
+    doc = (cb)(cbdata, NULL, sizeof(_mmd_doc_t));
+  else
+    doc = mmd_realloc(NULL, NULL, sizeof(_mmd_doc_t));
 
-  if (ret > 0)
-  {
-    // Copy bytes from the string...
-    memcpy(buffer, *s, ret);
-    (*s) += ret;
-  }
+  if (!doc)
+    return (NULL);
 
-  return (ret);
+  memset(doc, 0, sizeof(_mmd_doc_t));
+
+  doc->node.type  = MMD_TYPE_DOCUMENT;
+  doc->alloc_cb   = cb;
+  doc->alloc_data = cbdata;
+
+  return (&doc->node);
 }
 
 
 //
-// 'mmd_is_chars()' - Determine whether a line consists solely of whitespace
-//		      and the specified character.
+// 'mmdParseInlines()' - Parse the inline text of a node and its children.
+//
+// When the @code MMD_OPTION_LAZY_INLINE@ option is enabled, the inline text of
+// each block is parsed when its children are first accessed.  This function
+// parses any remaining inline text under the given node, for example before
+// sharing a document between threads.
 //
 
-static size_t				// O - 1 if as specified, 0 otherwise
-mmd_is_chars(const char *lineptr,	// I - Current line
-	     const char *chars,		// I - Non-space character
-	     size_t	minchars)	// I - Minimum number of non-space characters
+void
+mmdParseInlines(mmd_t *node)		// I - Node
 {
-  size_t	found_ch = 0;		// Did we find the specified characters?
+  _mmd_doc_t	*doc;			// Document
+  mmd_t		*current,		// Current node
+		*next;			// Next node
 
-  while (*lineptr == *chars)
-  {
-    found_ch ++;
-    lineptr ++;
-  }
 
-  if (minchars > 1)
+  if ((doc = mmd_doc(node)) == NULL || !doc->num_lazy)
+    return;
+
+  for (current = node; current; current = next)
   {
-    while (*lineptr && strchr(chars, *lineptr))
+    if (current->lazy)
+      mmd_parse_lazy(doc, current);
+
+    // Find the next node in the tree...
+    if ((next = current->first_child) == NULL && current != node)
     {
-      if (*lineptr == *chars)
-	found_ch ++;
+      for (next = current; next != node && !next->next_sibling; next = next->parent);
 
-      lineptr ++;
+      next = next == node ? NULL : next->next_sibling;
     }
   }
-
-  while (*lineptr && isspace(*lineptr & 255) && *lineptr != '\n')
-    lineptr ++;
-
-  if ((*lineptr && *lineptr != '\n') || found_ch < minchars)
-    return (0);
-  else
-    return (found_ch);
 }
 
 
 //
-// 'mmd_is_codefence()' - Determine whether the line contains a code fence.
+// 'mmdParserFeed()' - Add markdown text to an incremental load.
+//
+// The text can be split anywhere, even in the middle of a line or UTF-8
+// sequence.  Top-level blocks are loaded once enough text has been fed while
+// the text for any unfinished blocks is kept until the next call.
 //
 
-static size_t				// O - Length of fence or 0 otherwise
-mmd_is_codefence(char	*lineptr,	// I - Line
-		 char	fence,		// I - Current fence character, if any
-		 size_t fencelen,	// I - Current fence length
-		 char	**language)	// O - Language name, if any
+bool					// O - `true` on success, `false` on error
+mmdParserFeed(mmd_parser_t *parser,	// I - Parser
+              const char   *data,	// I - Markdown text
+              size_t       bytes)	// I - Number of bytes of text
 {
-  char		match = fence;		// Character to match
-  size_t	len = 0;		// Length of fence chars
+  char		*ptr,			// Pointer to current line
+		*next,			// Pointer to next line
+		*end;			// End of buffered text
 
 
-  if (language)
-    *language = NULL;
-
-  if (!match)
+  if (!parser || (!data && bytes))
   {
-    if (*lineptr == '~' || *lineptr == '`')
-      match = *lineptr;
-    else
-      return (0);
+    errno = EINVAL;
+    return (false);
   }
 
-  while (*lineptr == match)
+  if (parser->doc->error)
   {
-    lineptr ++;
-    len ++;
+    errno = parser->doc->error;
+    return (false);
   }
 
-  if (len < 3 || (fencelen && len < fencelen))
-    return (0);
+  parser->bytes += bytes;
 
-  if (*lineptr && *lineptr != '\n' && fence)
-    return (0);
-  else if (*lineptr && *lineptr != '\n' && !fence)
+  if (mmd_limits[MMD_LIMIT_BYTES] && parser->bytes > mmd_limits[MMD_LIMIT_BYTES])
   {
-    if (match == '`' && strchr(lineptr, match))
-      return (0);
+    DEBUG_printf("mmdParserFeed: Too many bytes (%lu).\n", (unsigned long)parser->bytes);
+    errno = parser->doc->error = EFBIG;
+    return (false);
+  }
 
-    while (isspace(*lineptr & 255))
-      lineptr ++;
+  // Add the text to the buffer...
+  if (bytes > (parser->alloc - parser->used))
+  {
+    size_t	alloc;			// New size of buffer
+    char	*temp;			// New buffer
 
-    if (*lineptr && language)
+    for (alloc = parser->alloc ? 2 * parser->alloc : 65536; alloc < (parser->used + bytes); alloc *= 2);
+
+    if ((temp = mmd_realloc(parser->doc, parser->buffer, alloc)) == NULL)
     {
-      *language = lineptr;
+      errno = parser->doc->error = ENOMEM;
+      return (false);
+    }
 
-      while (*lineptr && !isspace(*lineptr & 255))
-      {
-	if (*lineptr == '\\' && lineptr[1])
-	{
-	  // Remove "\"
-	  memmove(lineptr, lineptr + 1, strlen(lineptr));
-	}
+    parser->buffer = temp;
+    parser->alloc  = alloc;
+  }
 
-	lineptr ++;
-      }
-      *lineptr = '\0';
+  memcpy(parser->buffer + parser->used, data, bytes);
+  parser->used += bytes;
+
+  // Look for places to split in the new lines...
+  for (ptr = parser->buffer + parser->scanned, end = parser->buffer + parser->used; ptr < end; ptr = next)
+  {
+    if ((next = memchr(ptr, '\n', (size_t)(end - ptr))) == NULL)
+      break;
+
+    next ++;
+
+    if (mmd_parallel_line(&parser->split, ptr, next))
+      parser->split_at = (size_t)(ptr - parser->buffer);
+  }
+
+  parser->scanned = (size_t)(ptr - parser->buffer);
+
+  // Load the text before the last place to split...
+  if (parser->split_at >= MMD_FEED_MIN && parser->split_at >= parser->min_split && !mmd_parser_load(parser, parser->split_at, false))
+  {
+    if (parser->doc->error)
+    {
+      errno = parser->doc->error;
+      return (false);
     }
+
+    // The split was inside a code fence or before metadata, so wait until there
+    // is twice as much text before trying again...
+    parser->min_split = 2 * parser->split_at;
   }
 
-  return (len);
+  return (true);
 }
 
 
 //
-// 'mmd_is_table()' - Look ahead to see if the next line contains a heading
-//		      divider for a table.
+// 'mmdParserFinish()' - Finish an incremental load.
+//
+// Any remaining text is loaded and the parser is freed.  The parser cannot be
+// used after this call.
 //
 
-static bool				// O - `true` if this is a table, `false` otherwise
-mmd_is_table(_mmd_filebuf_t *file,	// I - File to read from
-	     int	    indent)	// I - Indentation of table line
+mmd_t *					// O - Root node or `NULL` on error
+mmdParserFinish(mmd_parser_t *parser)	// I - Parser
 {
-  const char	*ptr;			// Pointer into buffer
+  _mmd_doc_t	*doc;			// Document
+  mmd_t		*root,			// Root node
+		*last;			// Last node before load
 
 
-  ptr = file->bufptr;
-  while (*ptr)
+  if (!parser)
   {
-    if (!strchr(" \t>", *ptr))
-      break;
-
-    ptr ++;
+    errno = EINVAL;
+    return (NULL);
   }
 
-  if ((ptr - file->bufptr - indent) >= 4)
-    return (false);
+  if (!parser->doc->error && parser->used > 0)
+    mmd_parser_load(parser, parser->used, true);
 
-  while (*ptr)
-  {
-    if (!strchr(" \t:-|", *ptr))
-      break;
+  // Free the parser first since the document is freed on error...
+  doc  = parser->doc;
+  root = parser->root;
+  last = parser->last;
 
-    ptr ++;
-  }
+  mmd_release(doc, parser->buffer);
+  mmd_release(doc, parser);
 
-  return (*ptr == '\r' || *ptr == '\n');
+  return (mmd_load_end(doc, root, last));
 }
 
 
 //
-// 'mmd_parse_inline()' - Parse inline formatting.
+// 'mmdParserNew()' - Start an incremental load.
+//
+// The returned parser loads markdown text as it is passed to `mmdParserFeed`,
+// for example as it is received over a network connection.  Call
+// `mmdParserFinish` after the last of the text has been fed to get the
+// document.
+//
+// The current options and parse limits are used for the whole load.  The root
+// node must not be used by another load until the parser is finished.
 //
 
-static void
-mmd_parse_inline(_mmd_doc_t *doc,	// I - Document
-		 mmd_t	    *parent,	// I - Parent node
-		 char	    *lineptr)	// I - Pointer into line
+mmd_parser_t *				// O - Parser or `NULL` on error
+mmdParserNew(mmd_t *root)		// I - Root node for document or `NULL` for a new document
 {
-  mmd_t		*node;			// New node
-  mmd_type_t	type;			// Current node type
-  int		whitespace;		// Whitespace precedes?
-  char		*text,			// Text fragment in line
-		*title,			// Link title
-		*url,			// URL in link
-		*refname;		// Reference name
-  const char	*delim = NULL;		// Delimiter
-  size_t	delimlen = 0;		// Length of delimiter
+  mmd_parser_t	*parser;		// Parser
+  _mmd_doc_t	*doc;			// Document
 
 
-  whitespace = parent->last_child != NULL;
+  if ((doc = mmd_load_begin(root)) == NULL)
+    return (NULL);
 
-  for (text = NULL, type = MMD_TYPE_NORMAL_TEXT; *lineptr; lineptr ++)
+  // Allocate the parser using the document's allocator...
+  if ((parser = mmd_realloc(doc, NULL, sizeof(mmd_parser_t))) == NULL)
   {
-    DEBUG2_printf("mmd_parse_inline: lineptr=%p(\"%s\"), type=%d, text=%p, whitespace=%d\n", lineptr, lineptr, type, text, whitespace);
+    doc->error = ENOMEM;
+    mmd_load_end(doc, root, doc->root->last_child);
+    return (NULL);
+  }
 
-    if (isspace(*lineptr & 255) && type != MMD_TYPE_CODE_TEXT)
-    {
-      if (text)
-      {
-	*lineptr = '\0';
-	mmd_add(parent, type, whitespace, text, NULL);
+  memset(parser, 0, sizeof(mmd_parser_t));
 
-	text = NULL;
-      }
+  parser->doc   = doc;
+  parser->root  = root;
+  parser->last  = doc->root->last_child;
+  parser->empty = (mmd_options & MMD_OPTION_METADATA) && !doc->root->first_child;
 
-      if (!strncmp(lineptr + 1, " \n", 2) && lineptr[3])
-      {
-	DEBUG2_printf("mmd_parse_inline: Adding hard break to %p(%d)\n", parent, parent->type);
-	mmd_add(parent, MMD_TYPE_HARD_BREAK, 0, NULL, NULL);
+  parser->split.metadata = parser->empty;
+
+  return (parser);
+}
+
+
+//
+// 'mmdReset()' - Remove all nodes from a document so it can be reused.
+//
+// The memory used by the document is kept for the next load into the same
+// root node, so documents of similar size can be loaded without allocating any
+// more memory.  Frozen documents can be loaded into again after a reset.
+//
+// A document cannot be reset while it is being loaded, for example from a
+// block callback.  The block callback of the document is kept.
+//
+
+void
+mmdReset(mmd_t *doc)			// I - Document root node
+{
+  _mmd_doc_t	*d;			// Document
+  size_t	i;			// Looping var
+  _mmd_chunk_t	*chunk,			// Current chunk
+		*next;			// Next chunk
+
+
+  if (!doc || doc->type != MMD_TYPE_DOCUMENT || doc->parent || ((_mmd_doc_t *)doc)->loading)
+  {
+    errno = EINVAL;
+    return;
+  }
+
+  d = (_mmd_doc_t *)doc;
+
+  // Remove all of the nodes...
+  doc->first_child  = doc->last_child = NULL;
+  d->num_lazy       = 0;
+  d->block_next     = NULL;
+  d->num_indexed    = 0;
+  d->unsorted_nodes = false;
+  d->num_headings   = 0;
+  d->free_nodes     = NULL;
+  d->frozen         = false;
+
+  memset(&d->stats, 0, sizeof(d->stats));
+
+  for (i = 0; i < MMD_NODES_MAX; i ++)
+    d->nodes[i].num_nodes = 0;
+
+  // Move the memory chunks to the spare list...
+  for (chunk = d->chunks; chunk; chunk = next)
+  {
+    next        = chunk->next;
+    chunk->next = d->spare;
+    d->spare    = chunk;
+  }
+
+  d->chunks = NULL;
+}
+
+
+//
+// 'mmdSave()' - Save a document to a file.
+//
+// The file uses a versioned binary format with a table of nodes followed by a
+// pool of strings, which can be loaded using `mmdLoadBinary` much faster than
+// the markdown can be parsed again.  Any unparsed inline text is parsed before
+// saving.  The node can also be a block, which is added to the document when
+// the file is loaded.
+//
+
+bool					// O - `true` on success, `false` on error
+mmdSave(mmd_t      *node,		// I - Document root node
+        const char *filename)		// I - File to save to
+{
+  FILE		*fp;			// File
+  mmd_t		*current;		// Current node
+  size_t	i,			// Looping var
+		num_nodes = 0,		// Number of nodes
+		pool_size = 0,		// Size of string pool
+		depth = 0,		// Depth of current node
+		max_depth = 0,		// Maximum depth of nodes
+		*parents;		// Index of the last node at each depth
+  unsigned char	header[MMD_BINARY_HEADER],
+					// File header
+		record[MMD_BINARY_RECORD];
+					// Node record
+  bool		ret;			// Return value
+
+
+  if (!node || !filename)
+  {
+    errno = EINVAL;
+    return (false);
+  }
+
+  mmdParseInlines(node);
+
+  // Count the nodes and string bytes...
+  for (current = node; current; current = mmd_walk(node, current, &depth))
+  {
+    num_nodes ++;
+
+    if (depth > max_depth)
+      max_depth = depth;
+
+    if (current->text)
+      pool_size += current->textlen + 1;
+    if (current->url)
+      pool_size += strlen(current->url) + 1;
+    if (current->extra)
+      pool_size += strlen(current->extra) + 1;
+  }
+
+  if (num_nodes >= MMD_BINARY_NONE || pool_size > MMD_BINARY_NONE)
+  {
+    errno = EFBIG;
+    return (false);
+  }
+
+  if ((parents = mmd_realloc(NULL, NULL, (max_depth + 1) * sizeof(size_t))) == NULL)
+    return (false);
+
+  if ((fp = fopen(filename, "wb")) == NULL)
+  {
+    mmd_release(NULL, parents);
+    return (false);
+  }
+
+  // Write the header...
+  memcpy(header, "MMDB", 4);
+  mmd_binary_put(header + 4, MMD_BINARY_VERSION);
+  mmd_binary_put(header + 8, num_nodes);
+  mmd_binary_put(header + 12, pool_size);
+
+  ret = fwrite(header, sizeof(header), 1, fp) == 1;
+
+  // Then the nodes in depth-first order, followed by their strings in the same
+  // order...
+  for (current = node, i = 0; ret && current; current = mmd_walk(node, current, &depth), i ++)
+  {
+    parents[depth] = i;
+
+    record[0] = (unsigned char)current->type;
+    record[1] = (unsigned char)((current->whitespace ? MMD_BINARY_WHITESPACE : 0) | (current->text ? MMD_BINARY_TEXT : 0) | (current->url ? MMD_BINARY_URL : 0) | (current->extra ? MMD_BINARY_EXTRA : 0));
+    record[2] = 0;
+    record[3] = 0;
+
+    mmd_binary_put(record + 4, depth ? parents[depth - 1] : MMD_BINARY_NONE);
+    mmd_binary_put(record + 8, current->text ? current->textlen : 0);
+
+    ret = fwrite(record, sizeof(record), 1, fp) == 1;
+  }
+
+  // And finally the strings...
+  for (current = node; ret && current; current = mmd_walk(node, current, &depth))
+  {
+    if (current->text && fwrite(current->text, current->textlen + 1, 1, fp) != 1)
+      ret = false;
+    else if (current->url && fwrite(current->url, strlen(current->url) + 1, 1, fp) != 1)
+      ret = false;
+    else if (current->extra && fwrite(current->extra, strlen(current->extra) + 1, 1, fp) != 1)
+      ret = false;
+  }
+
+  mmd_release(NULL, parents);
+
+  if (fclose(fp))
+    ret = false;
+
+  if (!ret)
+    remove(filename);
+
+  return (ret);
+}
+
+
+//
+// 'mmdSetBlockCallback()' - Set a function to call as each top-level block of a
+//                           document is loaded.
+//
+// The callback function is called by the load functions as each top-level
+// block under the root node is completed, in document order, allowing the
+// block to be written out before the rest of the document has been loaded.
+// The callback is set on the document, so create the document with `mmdNew`
+// before loading into it.  Each document has its
+// own callback, so documents can be loaded in different threads.
+// The callback can free the block with `mmdFree`, in which case its memory is
+// reused for the following blocks so that large documents can be converted
+// using a bounded amount of memory.
+//
+// Blocks containing reference links are held until the link references are
+// found, or until the end of the document if they are never found, so that the
+// callback always sees the final link URLs.
+//
+// The callback must not modify or free any other nodes during the load, and
+// the callback cannot be changed during a load.  Pass `NULL` to stop calling a
+// function.
+//
+
+void
+mmdSetBlockCallback(
+    mmd_t          *doc,		// I - Document
+    mmd_block_cb_t cb,			// I - Callback function or `NULL` for none
+    void           *cbdata)		// I - Callback data
+{
+  _mmd_doc_t	*d;			// Document
+
+
+  if (!doc || doc->type != MMD_TYPE_DOCUMENT || doc->parent || ((_mmd_doc_t *)doc)->loading)
+  {
+    errno = EINVAL;
+    return;
+  }
+
+  d = (_mmd_doc_t *)doc;
+
+  d->doc_block_cb   = cb;
+  d->doc_block_data = cbdata;
+}
+
+
+//
+// 'mmdSetLimit()' - Set the value of a parse limit.
+//
+// Parse limits bound the resources used when loading untrusted markdown.  A
+// value of `0` disables the limit.  When a limit is exceeded the load
+// functions return `NULL` and set `errno` to `EFBIG`.
+//
+
+void
+mmdSetLimit(mmd_limit_t limit,		// I - Limit
+            size_t      value)		// I - Limit value or `0` for unlimited
+{
+  if (limit >= MMD_LIMIT_BYTES && limit <= MMD_LIMIT_INLINE)
+    mmd_limits[limit] = value;
+}
+
+
+//
+// 'mmdSetOptions()' - Set (enable/disable) support for various markdown options.
+//
+
+void
+mmdSetOptions(mmd_option_t options)	// I - Options
+{
+  mmd_options = options;
+}
+
+
+//
+// 'mmdSetStrings()' - Set the string table for a document.
+//
+// The document stores its URLs, code block languages, and metadata text in the
+// string table, so that each string is only stored once and equal strings have
+// equal pointers in all documents using the table.  The string table can only
+// be set for an empty document that is not being loaded, for example one that
+// was just created with `mmdNew`.  Pass `NULL` to store all strings with the
+// document.
+//
+
+void
+mmdSetStrings(mmd_t         *doc,	// I - Document
+              mmd_strings_t *strings)	// I - String table or `NULL` for none
+{
+  if (!doc || doc->type != MMD_TYPE_DOCUMENT || doc->parent || doc->first_child || ((_mmd_doc_t *)doc)->loading)
+  {
+    errno = EINVAL;
+    return;
+  }
+
+  ((_mmd_doc_t *)doc)->strings = strings;
+}
+
+
+//
+// 'mmdStringsFree()' - Free a string table.
+//
+// The string table must not be freed before the documents that use it.
+//
+
+void
+mmdStringsFree(mmd_strings_t *strings)	// I - String table
+{
+  _mmd_chunk_t	*chunk,			// Current chunk
+		*next;			// Next chunk
+
+
+  if (!strings)
+    return;
+
+#if _WIN32
+  DeleteCriticalSection(&strings->mutex);
+#else
+  pthread_mutex_destroy(&strings->mutex);
+#endif // _WIN32
+
+  for (chunk = strings->chunks; chunk; chunk = next)
+  {
+    next = chunk->next;
+    mmd_strings_realloc(strings, chunk, 0);
+  }
+
+  mmd_strings_realloc(strings, strings->strings, 0);
+  mmd_strings_realloc(strings, strings, 0);
+}
+
+
+//
+// 'mmdStringsNew()' - Create a string table.
+//
+// The string table is shared by the documents that it is set for with
+// `mmdSetStrings` and uses the specified allocator, as described for `mmdNew`.  Documents can be loaded using the same string table from multiple
+// threads.
+//
+
+mmd_strings_t *				// O - String table or `NULL` on error
+mmdStringsNew(mmd_alloc_cb_t cb,	// I - Allocator function or `NULL` for the default
+              void           *cbdata)	// I - Allocator data
+{
+  mmd_strings_t	*strings;		// String table
+
+
+  if (cb)
+    strings = (cb)(cbdata, NULL, sizeof(mmd_strings_t));
+  else
+    strings = mmd_realloc(NULL, NULL, sizeof(mmd_strings_t));
+
+  if (!strings)
+    return (NULL);
+
+  memset(strings, 0, sizeof(mmd_strings_t));
+
+  strings->alloc_cb   = cb;
+  strings->alloc_data = cbdata;
+
+#if _WIN32
+  InitializeCriticalSection(&strings->mutex);
+#else
+  pthread_mutex_init(&strings->mutex, NULL);
+#endif // _WIN32
+
+  return (strings);
+}
+
+
+//
+// 'mmd_add()' - Add a new markdown node.
+//
+
+static mmd_t *				// O - New node
+mmd_add(_mmd_doc_t *doc,		// I - Document
+	mmd_t	   *parent,		// I - Parent node
+	mmd_type_t type,		// I - Node type
+	int	   whitespace,		// I - 1 if whitespace precedes this node
+	char	   *text,		// I - Text, if any
+	char	   *url)		// I - URL, if any
+{
+  mmd_t		*temp;			// New node
+
+
+  DEBUG2_printf("Adding %s to %p(%s), whitespace=%d, text=\"%s\", url=\"%s\"\n", mmd_type_string(type), parent, parent ? mmd_type_string(parent->type) : "", whitespace, text ? text : "(null)", url ? url : "(null)");
+
+  if (!parent && type != MMD_TYPE_DOCUMENT)
+    return (NULL);			// Only document nodes can be at the root
+
+  if (doc->error)
+    return (NULL);			// Don't add anything after an error
+
+  if (parent && parent->lazy)
+    mmd_parse_lazy(doc, parent);	// Keep inline text before the new node
+
+  // Enforce parse limits...
+  if (mmd_limits[MMD_LIMIT_NODES] && doc->num_nodes >= mmd_limits[MMD_LIMIT_NODES])
+  {
+    DEBUG_printf("mmd_add: Too many nodes (%lu).\n", (unsigned long)doc->num_nodes);
+    doc->error = EFBIG;
+    return (NULL);
+  }
+
+  if (parent && type < MMD_TYPE_NORMAL_TEXT && mmd_limits[MMD_LIMIT_DEPTH])
+  {
+    // Count the number of block levels above the root...
+    size_t	depth = 1;		// Depth of new block
+    mmd_t	*current;		// Current ancestor
+
+    for (current = parent; current->parent; current = current->parent)
+      depth ++;
+
+    if (depth > mmd_limits[MMD_LIMIT_DEPTH])
+    {
+      DEBUG_printf("mmd_add: Blocks nested too deeply (%lu).\n", (unsigned long)depth);
+      doc->error = EFBIG;
+      return (NULL);
+    }
+  }
+  else if (type >= MMD_TYPE_NORMAL_TEXT && mmd_limits[MMD_LIMIT_INLINE])
+  {
+    // Count the number of inline nodes in the current block...
+    if (parent != doc->inline_parent)
+    {
+      doc->inline_parent = parent;
+      doc->num_inline    = 0;
+    }
+
+    if (doc->num_inline >= mmd_limits[MMD_LIMIT_INLINE])
+    {
+      DEBUG_printf("mmd_add: Too many inline nodes (%lu).\n", (unsigned long)doc->num_inline);
+      doc->error = EFBIG;
+      return (NULL);
+    }
+
+    doc->num_inline ++;
+  }
+
+  if (doc->block_cb && parent == doc->root)
+  {
+    // Starting a new top-level block, so report the blocks before it and give
+    // the new block its own memory chunks...
+    mmd_flush_code(doc);
+    mmd_block_done(doc, true);
+
+    if (doc->num_held >= doc->alloc_held && doc->first_held > 0)
+    {
+      // Compact the unreported blocks...
+      doc->num_held -= doc->first_held;
+      memmove(doc->held, doc->held + doc->first_held, doc->num_held * sizeof(_mmd_held_t));
+      doc->first_held = 0;
+    }
+    else if (doc->num_held >= doc->alloc_held)
+    {
+      _mmd_held_t *held;		// New unreported blocks
+      size_t	alloc_held = doc->alloc_held + 16;
+					// New allocation size
+
+      if ((held = mmd_realloc(doc, doc->held, alloc_held * sizeof(_mmd_held_t))) == NULL)
+      {
+        doc->error = ENOMEM;
+        return (NULL);
+      }
+
+      doc->held       = held;
+      doc->alloc_held = alloc_held;
+    }
+
+    doc->held[doc->num_held].block  = NULL;
+    doc->held[doc->num_held].chunks = NULL;
+    doc->cur_held                   = ++ doc->num_held;
+  }
+
+  if ((temp = doc->free_nodes) != NULL)
+  {
+    // Reuse a freed node...
+    doc->free_nodes = temp->first_child;
+  }
+  else
+  {
+    temp = mmd_alloc(doc, sizeof(mmd_t));
+  }
+
+  if (temp)
+  {
+    memset(temp, 0, sizeof(mmd_t));
+
+    if (doc->block_cb && parent == doc->root)
+    {
+      doc->held[doc->cur_held - 1].block = temp;
+
+      if (!doc->block_next)
+        doc->block_next = temp;
+    }
+
+    doc->num_nodes ++;
+
+    if (parent)
+    {
+      // Add node to the parent...
+      temp->parent = parent;
+
+      if (parent->last_child)
+      {
+	parent->last_child->next_sibling = temp;
+	temp->prev_sibling		 = parent->last_child;
+	parent->last_child		 = temp;
+      }
+      else
+      {
+	parent->first_child = parent->last_child = temp;
+      }
+    }
+
+    // Copy the node values...
+    temp->type	     = type;
+    temp->whitespace = whitespace;
+
+    if (text)
+    {
+      temp->textlen = strlen(text);
+
+      if (type == MMD_TYPE_METADATA_TEXT)
+        temp->text = mmd_intern(doc, text);
+      else
+        temp->text = mmd_strndup(doc, text, temp->textlen);
+    }
+
+    if (url)
+      temp->url = mmd_intern(doc, url);
+
+    mmd_nodes_add(doc, temp);
+
+    doc->stats.nodes[type] ++;
+  }
+
+  return (temp);
+}
+
+
+//
+// 'mmd_add_code()' - Add a line of text to a code block.
+//
+// When the `MMD_OPTION_CODE_BLOCK_TEXT` option is set, lines are collected in
+// a buffer and added as a single text node by `mmd_flush_code()`.
+//
+
+static void
+mmd_add_code(_mmd_doc_t *doc,		// I - Document
+             mmd_t      *parent,	// I - Code block
+             const char *text)		// I - Line of code text
+{
+  size_t	len;			// Length of text
+
+
+  if (!(mmd_options & MMD_OPTION_CODE_BLOCK_TEXT))
+  {
+    mmd_add(doc, parent, MMD_TYPE_CODE_TEXT, 0, (char *)text, NULL);
+    return;
+  }
+
+  if (parent != doc->code_block)
+  {
+    mmd_flush_code(doc);
+    doc->code_block = parent;
+  }
+
+  len = strlen(text);
+
+  if ((doc->code_len + len) >= doc->code_alloc)
+  {
+    // Grow the buffer...
+    size_t	alloc = doc->code_alloc ? 2 * doc->code_alloc : 1024;
+					// New size of buffer
+    char	*code;			// New buffer
+
+    while ((doc->code_len + len) >= alloc)
+      alloc *= 2;
+
+    if ((code = mmd_realloc(doc, doc->code, alloc)) == NULL)
+    {
+      doc->error = ENOMEM;
+      return;
+    }
+
+    doc->code       = code;
+    doc->code_alloc = alloc;
+  }
+
+  memcpy(doc->code + doc->code_len, text, len + 1);
+  doc->code_len += len;
+}
+
+
+//
+// 'mmd_add_inline()' - Add inline text to a block, parsing it now or later.
+//
+
+static void
+mmd_add_inline(_mmd_doc_t *doc,		// I - Document
+               mmd_t      *parent,	// I - Parent block
+               char       *lineptr)	// I - Inline text
+{
+  size_t	oldlen = 0,		// Length of unparsed text
+		len;			// Length of new text
+  char		*text;			// New unparsed text
+  double	start;			// Start time
+
+
+  if (!parent || !*lineptr)
+    return;
+
+  // Reference definitions are always parsed so that links in unparsed text can
+  // be resolved later...
+  if (!(mmd_options & MMD_OPTION_LAZY_INLINE) || strstr(lineptr, "]:"))
+  {
+    if (parent->lazy)
+      mmd_parse_lazy(doc, parent);
+
+    // Copy the text once so that the inline nodes can point into it...
+    len = strlen(lineptr) + 1;
+
+    if ((text = mmd_alloc(doc, len)) == NULL)
+      return;
+
+    memcpy(text, lineptr, len);
+
+    doc->inline_start = text;
+    doc->inline_end   = text + len;
+    start             = mmd_time();
+
+    mmd_parse_inline(doc, parent, text);
+
+    doc->inline_start      = doc->inline_end = NULL;
+    doc->stats.inline_time += mmd_time() - start;
+    return;
+  }
+
+  // Save the text as a list of nul-terminated segments ending with an empty
+  // string, since each segment is parsed separately...
+  if (parent->lazy)
+  {
+    for (text = parent->text; text[oldlen]; oldlen += strlen(text + oldlen) + 1);
+  }
+
+  len = strlen(lineptr) + 1;
+
+  if ((text = mmd_alloc(doc, oldlen + len + 1)) == NULL)
+    return;
+
+  if (oldlen)
+    memcpy(text, parent->text, oldlen);
+
+  memcpy(text + oldlen, lineptr, len);
+  text[oldlen + len] = '\0';
+
+  if (!parent->lazy)
+  {
+    parent->lazy = true;
+    doc->num_lazy ++;
+  }
+
+  parent->text = text;
+}
+
+
+//
+// 'mmd_alloc()' - Allocate memory for a node or string.
+//
+// Memory is allocated from the document's chunks, which are only freed with the
+// document.  When a block callback is set, memory for each top-level block is
+// allocated from its own chunks so it can be reused once the callback frees
+// the block.  The returned memory is aligned for storing pointers.
+//
+
+static void *				// O - Memory or `NULL` on error
+mmd_alloc(_mmd_doc_t *doc,		// I - Document
+          size_t     bytes)		// I - Number of bytes
+{
+  _mmd_chunk_t	**chunks,		// Chunk list
+		*chunk;			// Current chunk
+  void		*ptr;			// Allocated memory
+
+
+  // Round up for alignment...
+  bytes = (bytes + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+
+  // Use the chunks for the current top-level block, which are freed with it...
+  if (doc->cur_held)
+    chunks = &doc->held[doc->cur_held - 1].chunks;
+  else
+    chunks = &doc->chunks;
+
+  chunk = *chunks;
+
+  if (!chunk || (chunk->size - chunk->used) < bytes)
+  {
+    // Reuse a spare chunk from a previous load or allocate a new chunk,
+    // doubling in size each time...
+    _mmd_chunk_t **spare;		// Pointer to spare chunk
+
+    for (spare = &doc->spare; *spare; spare = &(*spare)->next)
+    {
+      if ((*spare)->size >= bytes)
+        break;
+    }
+
+    if (*spare)
+    {
+      chunk  = *spare;
+      *spare = chunk->next;
+    }
+    else
+    {
+      size_t size = *chunks ? 2 * (*chunks)->size : doc->cur_held ? MMD_CHUNK_BLOCK : MMD_CHUNK_MIN;
+					// Size of new chunk
+
+      if (size > MMD_CHUNK_MAX)
+	size = MMD_CHUNK_MAX;
+      if (size < bytes)
+	size = bytes;
+
+      if ((chunk = mmd_realloc(doc, NULL, sizeof(_mmd_chunk_t) + size)) == NULL)
+      {
+	doc->error = ENOMEM;
+	return (NULL);
+      }
+
+      DEBUG2_printf("mmd_alloc: New chunk %p with %lu bytes.\n", chunk, (unsigned long)size);
+
+      chunk->size = size;
+
+      doc->stats.chunks ++;
+    }
+
+    chunk->next = *chunks;
+    chunk->used = 0;
+    *chunks     = chunk;
+  }
+
+  ptr = (char *)(chunk + 1) + chunk->used;
+  chunk->used += bytes;
+
+  doc->stats.allocs ++;
+  doc->stats.alloc_bytes += bytes;
+
+  return (ptr);
+}
+
+
+//
+// 'mmd_binary_get()' - Get a 32-bit value from a binary document.
+//
+
+static size_t				// O - Value
+mmd_binary_get(
+    const unsigned char *buffer)	// I - Buffer
+{
+  return ((size_t)buffer[0] | ((size_t)buffer[1] << 8) | ((size_t)buffer[2] << 16) | ((size_t)buffer[3] << 24));
+}
+
+
+//
+// 'mmd_binary_put()' - Put a 32-bit value in a binary document.
+//
+
+static void
+mmd_binary_put(unsigned char *buffer,	// I - Buffer
+               size_t        value)	// I - Value
+{
+  buffer[0] = (unsigned char)value;
+  buffer[1] = (unsigned char)(value >> 8);
+  buffer[2] = (unsigned char)(value >> 16);
+  buffer[3] = (unsigned char)(value >> 24);
+}
+
+
+//
+// 'mmd_block_chunks()' - Keep or free the memory chunks of a top-level block.
+//
+// Kept chunks are moved to the document's chunks, while freed chunks are moved
+// to the spare list for reuse.
+//
+
+static void
+mmd_block_chunks(_mmd_doc_t *doc,	// I - Document
+                 size_t     cur,	// I - Unreported block (index + 1)
+                 bool       keep)	// I - Keep the memory with the document?
+{
+  _mmd_held_t	*held = doc->held + cur - 1;
+					// Unreported block
+  _mmd_chunk_t	*chunk,			// Current chunk
+		*next;			// Next chunk
+
+
+  for (chunk = held->chunks; chunk; chunk = next)
+  {
+    next = chunk->next;
+
+    if (!keep)
+    {
+      chunk->next = doc->spare;
+      doc->spare  = chunk;
+    }
+    else if (doc->chunks)
+    {
+      // Add behind the current chunk so it stays current...
+      chunk->next       = doc->chunks->next;
+      doc->chunks->next = chunk;
+    }
+    else
+    {
+      chunk->next = NULL;
+      doc->chunks = chunk;
+    }
+  }
+
+  held->block  = NULL;
+  held->chunks = NULL;
+
+  if (doc->cur_held == cur)
+    doc->cur_held = 0;
+
+  // Remove reported blocks from the ends of the array...
+  while (doc->first_held < doc->num_held && !doc->held[doc->first_held].block)
+    doc->first_held ++;
+
+  while (doc->num_held > doc->first_held && !doc->held[doc->num_held - 1].block)
+    doc->num_held --;
+
+  if (doc->first_held == doc->num_held)
+    doc->first_held = doc->num_held = 0;
+}
+
+
+//
+// 'mmd_block_done()' - Report completed top-level blocks to the block callback.
+//
+// Blocks are held while any reference links are unresolved so that the
+// callback always sees the final link URLs.
+//
+
+static void
+mmd_block_done(_mmd_doc_t *doc,		// I - Document
+               bool       all)		// I - Report the last block too?
+{
+  mmd_t		*block;			// Current block
+  size_t	cur,			// Unreported block for block
+		cur_held = doc->cur_held;
+					// Current allocation block
+
+
+  if (doc->num_pending > 0)
+    return;
+
+  while ((block = doc->block_next) != NULL && (all || block != doc->root->last_child))
+  {
+    DEBUG2_printf("mmd_block_done: block=%p(%s)\n", block, mmd_type_string(block->type));
+
+    // Anything allocated for the block now belongs to the block - blocks are
+    // reported in order, so it is the first unreported block unless it was
+    // loaded in parallel...
+    if (doc->first_held < doc->num_held && doc->held[doc->first_held].block == block)
+      cur = doc->first_held + 1;
+    else
+      cur = 0;
+
+    doc->cur_held = cur;
+
+    // Parse any unparsed inline text, since it may contain links to references
+    // that have not been loaded yet...
+    if (doc->num_lazy)
+    {
+      mmdParseInlines(block);
+
+      if (doc->num_pending > 0)
+        break;
+    }
+
+    doc->block_next = block->next_sibling;
+
+    (doc->block_cb)(doc->block_data, block);
+
+    // Free the block's memory if the callback freed the block...
+    if (!block->parent)
+      doc->block_freed = true;
+
+    if (cur)
+      mmd_block_chunks(doc, cur, block->parent != NULL);
+  }
+
+  // Restore the current allocation block unless it was reported...
+  if (cur_held && cur_held <= doc->num_held && doc->held[cur_held - 1].block)
+    doc->cur_held = cur_held;
+  else
+    doc->cur_held = 0;
+}
+
+
+//
+// 'mmd_block_top()' - Get the top-level block containing a node.
+//
+
+static mmd_t *				// O - Top-level block
+mmd_block_top(_mmd_doc_t *doc,		// I - Document
+              mmd_t      *node)		// I - Node
+{
+  while (node->parent && node->parent != doc->root)
+    node = node->parent;
+
+  return (node);
+}
+
+
+//
+// 'mmd_doc()' - Find the document containing a node.
+//
+
+static _mmd_doc_t *			// O - Document or `NULL` if none
+mmd_doc(mmd_t *node)			// I - Node
+{
+  while (node->parent)
+    node = node->parent;
+
+  return (node->type == MMD_TYPE_DOCUMENT ? (_mmd_doc_t *)node : NULL);
+}
+
+
+//
+// 'mmd_find_delim()' - Find the next closing delimiter in a line.
+//
+// The positions of all delimiter characters after "lineptr" are found the
+// first time the line is searched, then each delimiter keeps its own position
+// in the index since "lineptr" only moves forward.  This avoids rescanning the
+// rest of the line for every unmatched delimiter.
+//
+
+static char *				// O - Closing delimiter or `NULL` if none
+mmd_find_delim(_mmd_doc_t   *doc,	// I - Document
+               _mmd_index_t *index,	// I - Delimiter index
+               char         *lineptr,	// I - Pointer to opening delimiter
+               const char   *delim,	// I - Delimiter
+               size_t       delimlen)	// I - Length of delimiter
+{
+  char		*ptr;			// Pointer into line
+  size_t	i,			// Looping var
+		which;			// Which delimiter
+
+
+  if (!index->start)
+  {
+    // Index the delimiters in the rest of the line...
+    index->start      = lineptr;
+    index->num_delims = 0;
+
+    memset(index->next, 0, sizeof(index->next));
+
+    for (ptr = lineptr; *ptr; ptr ++)
+    {
+      if (*ptr != '*' && *ptr != '_' && *ptr != '`' && *ptr != '>')
+        continue;
+
+      if (index->num_delims >= doc->alloc_delims)
+      {
+        size_t *delims;			// New delimiter positions
+
+        if ((delims = mmd_realloc(doc, doc->delims, (doc->alloc_delims + 1024) * sizeof(size_t))) == NULL)
+        {
+          index->start = NULL;
+          return (strstr(lineptr + delimlen, delim));
+        }
+
+        doc->delims       = delims;
+        doc->alloc_delims += 1024;
+      }
+
+      doc->delims[index->num_delims ++] = (size_t)(ptr - lineptr);
+    }
+  }
+
+  switch (*delim)
+  {
+    case '*' :
+        which = delimlen - 1;
+        break;
+    case '_' :
+        which = delimlen + 1;
+        break;
+    case '`' :
+        which = delimlen + 3;
+        break;
+    default :
+        which = 7;
+        break;
+  }
+
+  // Skip delimiters before this one and those that don't match...
+  for (i = index->next[which]; i < index->num_delims; i ++)
+  {
+    ptr = index->start + doc->delims[i];
+
+    if (ptr >= (lineptr + delimlen) && !strncmp(ptr, delim, delimlen))
+      break;
+  }
+
+  index->next[which] = i;
+
+  return (i < index->num_delims ? ptr : NULL);
+}
+
+//
+// 'mmd_flush_code()' - Add any buffered code text to its code block.
+//
+
+static void
+mmd_flush_code(_mmd_doc_t *doc)		// I - Document
+{
+  if (doc->code_block && doc->code_len > 0)
+    mmd_add(doc, doc->code_block, MMD_TYPE_CODE_TEXT, 0, doc->code, NULL);
+
+  doc->code_block = NULL;
+  doc->code_len   = 0;
+}
+
+
+//
+// 'mmd_free()' - Free memory used by a node.
+//
+
+static void
+mmd_free(mmd_t *node)			// I - Node
+{
+  if (node->type == MMD_TYPE_DOCUMENT && !node->parent)
+  {
+    // Free the document's references and memory chunks...
+    _mmd_doc_t		*doc = (_mmd_doc_t *)node;
+					// Document
+    _mmd_chunk_t	*chunk,		// Current chunk
+			*next;		// Next chunk
+    size_t		i;		// Looping var
+
+    for (i = 0; i < doc->alloc_references; i ++)
+      mmd_release(doc, doc->references[i].pending);
+
+    mmd_release(doc, doc->references);
+    mmd_release(doc, doc->refhash);
+    mmd_release(doc, doc->deferred);
+    mmd_release(doc, doc->delims);
+    mmd_release(doc, doc->code);
+
+    for (chunk = doc->chunks; chunk; chunk = next)
+    {
+      next = chunk->next;
+      mmd_release(doc, chunk);
+    }
+
+    mmd_release(doc, doc->held);
+
+    for (i = 0; i < MMD_NODES_MAX; i ++)
+      mmd_release(doc, doc->nodes[i].nodes);
+
+    mmd_release(doc, doc->headings);
+
+    for (chunk = doc->spare; chunk; chunk = next)
+    {
+      next = chunk->next;
+      mmd_release(doc, chunk);
+    }
+
+    mmd_release(doc, doc);
+  }
+}
+
+
+//
+// 'mmd_free_nodes()' - Keep the nodes of a removed tree for reuse.
+//
+// The nodes are linked using their `first_child` pointers.  Nodes are not
+// reused while blocks are being reported, since the memory of a reported block
+// is reused as a whole, or while links are waiting for a reference.
+//
+
+static void
+mmd_free_nodes(_mmd_doc_t *doc,		// I - Document
+               mmd_t      *node)	// I - Top node of removed tree
+{
+  mmd_t		*current,		// Current node
+		*next;			// Next node
+  size_t	depth = 0;		// Depth of current node
+
+
+  if (doc->block_cb || doc->num_pending)
+    return;
+
+  for (current = node; current; current = next)
+  {
+    next                 = mmd_walk(node, current, &depth);
+    current->first_child = doc->free_nodes;
+    doc->free_nodes      = current;
+  }
+
+  doc->inline_parent = NULL;
+}
+
+
+//
+// 'mmd_has_continuation()' - Determine whether the next line is a continuation
+//			      of the current one.
+//
+
+static int				// O - 1 if the next line continues, 0 otherwise
+mmd_has_continuation(
+    const char	   *line,		// I - Current line
+    _mmd_filebuf_t *file,		// I - File buffer
+    int		   indent)		// I - Indentation for current block
+{
+  const char	*lineptr = line;	// Pointer into current line
+  const char	*fileptr = file->bufptr;// Pointer into next line
+
+
+  if (*fileptr == '\n' || *fileptr == '\r')
+    return (0);
+
+  do
+  {
+    while (isspace(*lineptr & 255))
+      lineptr ++;
+
+    if (*lineptr == '[' && (lineptr - line - indent) < 4 && (*fileptr == ' ' || *fileptr == '\t'))
+      return (1);
+
+    while (isspace(*fileptr & 255))
+      fileptr ++;
+
+    if (*lineptr == '>' && *fileptr == '>')
+    {
+      lineptr ++;
+      fileptr ++;
+    }
+    else if (*fileptr == '>')
+      return (0);
+
+    if (*fileptr == '\n' || *fileptr == '\r')
+      return (0);
+  }
+  while (isspace(*lineptr & 255) || isspace(*fileptr & 255));
+
+  if (*lineptr == '#')
+    return (0);
+
+  if (strchr("-+*", *fileptr) && isspace(fileptr[1] & 255))
+  {
+    // Bullet list item...
+    return (0);
+  }
+
+  if (isdigit(*fileptr & 255))
+  {
+    // Ordered list item...
+    while (*fileptr && isdigit(*fileptr & 255))
+      fileptr ++;
+
+    if (*fileptr == '.' || *fileptr == '(')
+      return (0);
+  }
+
+  if (mmd_is_codefence((char *)fileptr, '\0', 0, NULL))
+    return (0);
+
+  if (mmd_is_chars(fileptr, "- \t", 3) || mmd_is_chars(fileptr, "_ \t", 3) || mmd_is_chars(fileptr, "* \t", 3))
+  {
+    // Thematic break...
+    return (0);
+  }
+
+  if (mmd_is_chars(fileptr, "-", 1) || mmd_is_chars(fileptr, "=", 1))
+  {
+    // Heading...
+    return (0);
+  }
+
+  if (*fileptr == '#')
+  {
+    // Possible heading...
+    int count = 0;
+
+    while (*fileptr == '#')
+    {
+      fileptr ++;
+      count ++;
+    }
+
+    if (count <= 6)
+      return (0);
+  }
+
+  return ((fileptr - file->bufptr) <= indent);
+}
+
+
+//
+// 'mmd_intern()' - Copy a string into the document's string table.
+//
+// Strings are copied into the document's memory when there is no string table.
+//
+
+static char *				// O - Copy of string
+mmd_intern(_mmd_doc_t *doc,		// I - Document
+           const char *s)		// I - String
+{
+  char	*ret;				// Copy of string
+
+
+  if (!doc->strings)
+    return (mmd_strdup(doc, s));
+
+  if ((ret = mmd_strings_add(doc->strings, s)) == NULL)
+    doc->error = ENOMEM;
+
+  return (ret);
+}
+
+
+//
+// 'mmd_iocb_buffer()' - Read from a memory buffer.
+//
+
+static size_t				// O - Number of bytes read
+mmd_iocb_buffer(_mmd_membuf_t *buf,	// I - Memory buffer
+                char          *buffer,	// I - Buffer
+                size_t        bytes)	// I - Number of bytes to read
+{
+  size_t	ret;			// Bytes read/returned
+
+
+  // See how many bytes remain in the buffer...
+  if ((ret = (size_t)(buf->end - buf->ptr)) > bytes)
+    ret = bytes;
+
+  if (ret > 0)
+  {
+    // Copy bytes from the buffer...
+    memcpy(buffer, buf->ptr, ret);
+    buf->ptr += ret;
+  }
+
+  return (ret);
+}
+
+
+//
+// 'mmd_iocb_file()' - Read from a file.
+//
+
+static size_t				// O - Number of bytes read
+mmd_iocb_file(FILE   *fp,		// I - File pointer
+              char   *buffer,		// I - Buffer
+              size_t bytes)		// I - Number of bytes to read
+{
+  return (fread(buffer, 1, bytes, fp));
+}
+
+
+//
+// 'mmd_iocb_line()' - Read a line from a file.
+//
+
+static size_t				// O - Number of bytes read
+mmd_iocb_line(FILE   *fp,		// I - File pointer
+              char   *buffer,		// I - Buffer
+              size_t bytes)		// I - Number of bytes to read
+{
+  if (bytes < 2 || !fgets(buffer, (int)bytes, fp))
+    return (0);
+
+  return (strlen(buffer));
+}
+
+
+//
+// 'mmd_is_chars()' - Determine whether a line consists solely of whitespace
+//		      and the specified character.
+//
+
+static size_t				// O - 1 if as specified, 0 otherwise
+mmd_is_chars(const char *lineptr,	// I - Current line
+	     const char *chars,		// I - Non-space character
+	     size_t	minchars)	// I - Minimum number of non-space characters
+{
+  size_t	found_ch = 0;		// Did we find the specified characters?
+
+  while (*lineptr == *chars)
+  {
+    found_ch ++;
+    lineptr ++;
+  }
+
+  if (minchars > 1)
+  {
+    while (*lineptr && strchr(chars, *lineptr))
+    {
+      if (*lineptr == *chars)
+	found_ch ++;
+
+      lineptr ++;
+    }
+  }
+
+  while (*lineptr && isspace(*lineptr & 255) && *lineptr != '\n')
+    lineptr ++;
+
+  if ((*lineptr && *lineptr != '\n') || found_ch < minchars)
+    return (0);
+  else
+    return (found_ch);
+}
+
+
+//
+// 'mmd_is_codefence()' - Determine whether the line contains a code fence.
+//
+
+static size_t				// O - Length of fence or 0 otherwise
+mmd_is_codefence(char	*lineptr,	// I - Line
+		 char	fence,		// I - Current fence character, if any
+		 size_t fencelen,	// I - Current fence length
+		 char	**language)	// O - Language name, if any
+{
+  char		match = fence;		// Character to match
+  size_t	len = 0;		// Length of fence chars
+
+
+  if (language)
+    *language = NULL;
+
+  if (!match)
+  {
+    if (*lineptr == '~' || *lineptr == '`')
+      match = *lineptr;
+    else
+      return (0);
+  }
+
+  while (*lineptr == match)
+  {
+    lineptr ++;
+    len ++;
+  }
+
+  if (len < 3 || (fencelen && len < fencelen))
+    return (0);
+
+  if (*lineptr && *lineptr != '\n' && fence)
+    return (0);
+  else if (*lineptr && *lineptr != '\n' && !fence)
+  {
+    if (match == '`')
+    {
+      // Backtick fences cannot have backticks in the info string...
+      const char *ptr;			// Pointer into line
+
+      for (ptr = lineptr; *ptr && *ptr != '\n'; ptr ++)
+      {
+        if (*ptr == match)
+          return (0);
+      }
+    }
+
+    while (isspace(*lineptr & 255))
+      lineptr ++;
+
+    if (*lineptr && language)
+    {
+      char *ptr;			// Output pointer
+
+      *language = ptr = lineptr;
+
+      while (*lineptr && !isspace(*lineptr & 255))
+      {
+	if (*lineptr == '\\' && lineptr[1])
+	{
+	  // Remove "\"
+	  lineptr ++;
+	}
+
+	*ptr++ = *lineptr++;
+      }
+      *ptr = '\0';
+    }
+  }
+
+  return (len);
+}
+
+
+//
+// 'mmd_is_table()' - Look ahead to see if the next line contains a heading
+//		      divider for a table.
+//
+
+static bool				// O - `true` if this is a table, `false` otherwise
+mmd_is_table(_mmd_filebuf_t *file,	// I - File to read from
+	     int	    indent)	// I - Indentation of table line
+{
+  const char	*ptr;			// Pointer into buffer
+
+
+  ptr = file->bufptr;
+  while (*ptr)
+  {
+    if (!strchr(" \t>", *ptr))
+      break;
+
+    ptr ++;
+  }
+
+  if ((ptr - file->bufptr - indent) >= 4)
+    return (false);
+
+  while (*ptr)
+  {
+    if (!strchr(" \t:-|", *ptr))
+      break;
+
+    ptr ++;
+  }
+
+  return (*ptr == '\r' || *ptr == '\n');
+}
+
+
+//
+// 'mmd_load_begin()' - Find or create the document for a load.
+//
+
+static _mmd_doc_t *			// O - Document or `NULL` on error
+mmd_load_begin(mmd_t *root)		// I - Root node for document or `NULL` for a new document
+{
+  _mmd_doc_t	*doc;			// Document
+
+
+  if (root)
+  {
+    // Find the document containing the root node, which cannot be frozen...
+    if ((doc = mmd_doc(root)) == NULL || doc->frozen)
+    {
+      errno = EINVAL;
+      return (NULL);
+    }
+  }
+  else if ((doc = (_mmd_doc_t *)mmdNew(NULL, NULL)) == NULL)
+  {
+    return (NULL);
+  }
+
+  // Parse any inline text left from a previous load using its references...
+  mmdParseInlines(&doc->node);
+
+  doc->root	      = root ? root : &doc->node;
+  doc->num_references = 0;
+  doc->num_nodes      = 0;
+  doc->inline_parent  = NULL;
+  doc->num_inline     = 0;
+  doc->in_fence	      = false;
+  doc->in_metadata    = false;
+  doc->loading	      = true;
+  doc->error	      = 0;
+  doc->block_cb	      = doc->defer_refs ? NULL : doc->doc_block_cb;
+  doc->block_data     = doc->doc_block_data;
+  doc->block_next     = NULL;
+  doc->block_freed    = false;
+  doc->index_nodes    = (mmd_options & MMD_OPTION_NODE_INDEX) != 0;
+
+  return (doc);
+}
+
+
+//
+// 'mmd_load_end()' - Finish a load, resolving references and handling errors.
+//
+
+static mmd_t *				// O - Root node or `NULL` on error
+mmd_load_end(_mmd_doc_t *doc,		// I - Document
+             mmd_t      *root,		// I - Root node passed to the load function
+             mmd_t      *last)		// I - Last node before load
+{
+  mmd_t		*node,			// Current node
+		*next;			// Next node
+  size_t	i;			// Looping var
+
+
+  // Add any buffered code text and convert any unresolved references to plain
+  // text, parsing the inline text of any unreported blocks first...
+  mmd_flush_code(doc);
+
+  if (doc->block_cb && doc->num_lazy)
+  {
+    for (node = doc->block_next, i = doc->first_held; node; node = node->next_sibling)
+    {
+      if (i < doc->num_held && doc->held[i].block == node)
+        doc->cur_held = ++ i;
+      else
+        doc->cur_held = 0;
+
+      mmdParseInlines(node);
+    }
+  }
+
+  mmd_ref_clear(doc);
+
+  // Report the remaining top-level blocks and keep the memory of any that are
+  // left after an error...
+  if (doc->block_cb && !doc->error)
+    mmd_block_done(doc, true);
+
+  while (doc->num_held > 0)
+    mmd_block_chunks(doc, doc->num_held, true);
+
+  doc->loading	= false;
+  doc->block_cb	= NULL;
+
+  // Keep the references array for the next load, and the references for any
+  // unparsed inline text...
+  if (!doc->num_lazy)
+    doc->num_references = 0;
+
+  if (doc->error)
+  {
+    // Parse limit exceeded or out of memory, discard the nodes we added...
+    int error = doc->error;		// Error code
+
+    DEBUG_printf("mmd_load_end: Load failed (%s)\n", strerror(error));
+
+    if (root)
+    {
+      for (node = last ? last->next_sibling : root->first_child; node; node = next)
+      {
+        next = node->next_sibling;
+        mmdFree(node);
+      }
+    }
+    else
+    {
+      mmdFree(&doc->node);
+    }
+
+    errno = error;
+    return (NULL);
+  }
+
+  // Return the root node...
+  return (doc->root);
+}
+
+
+//
+// 'mmd_nodes_add()' - Add a node to the index of its type and the outline.
+//
+// Headings are always added to the outline, while other nodes are only indexed
+// when the `MMD_OPTION_NODE_INDEX` option is set.
+//
+
+static void
+mmd_nodes_add(_mmd_doc_t *doc,		// I - Document
+              mmd_t      *node)		// I - Node
+{
+  _mmd_nodes_t	*nodes;			// Indexed nodes
+
+
+  if (node->type >= MMD_TYPE_HEADING_1 && node->type <= MMD_TYPE_HEADING_6)
+    mmd_nodes_append(doc, doc->nodes + MMD_NODES_OUTLINE, node);
+
+  if (doc->index_nodes && (nodes = mmd_nodes_find(doc, node->type)) != NULL)
+    mmd_nodes_append(doc, nodes, node);
+}
+
+
+//
+// 'mmd_nodes_append()' - Append a node to an index.
+//
+
+static void
+mmd_nodes_append(_mmd_doc_t   *doc,	// I - Document
+                 _mmd_nodes_t *nodes,	// I - Indexed nodes
+                 mmd_t        *node)	// I - Node
+{
+  if (nodes->num_nodes >= nodes->alloc_nodes)
+  {
+    mmd_t	**temp;			// New nodes
+
+    if ((temp = mmd_realloc(doc, nodes->nodes, (nodes->alloc_nodes + 64) * sizeof(mmd_t *))) == NULL)
+    {
+      doc->error = ENOMEM;
+      return;
+    }
+
+    nodes->nodes       = temp;
+    nodes->alloc_nodes += 64;
+  }
+
+  nodes->nodes[nodes->num_nodes ++] = node;
+  doc->num_indexed ++;
+
+  // Inline text that is parsed lazily may be parsed in any order...
+  if (doc->num_lazy && node->type >= MMD_TYPE_NORMAL_TEXT)
+    doc->unsorted_nodes = true;
+}
+
+
+//
+// 'mmd_nodes_check()' - Remove indexed nodes whose type has changed.
+//
+
+static void
+mmd_nodes_check(_mmd_doc_t *doc)	// I - Document
+{
+  size_t	i,			// Looping var
+		j,			// Looping var
+		count;			// Number of nodes kept
+  _mmd_nodes_t	*nodes;			// Indexed nodes
+
+
+  // Only links and images change type, so the outline is left alone...
+  for (i = MMD_NODES_OUTLINE, nodes = doc->nodes; i > 0; i --, nodes ++)
+  {
+    for (j = 0, count = 0; j < nodes->num_nodes; j ++)
+    {
+      if (mmd_nodes_find(doc, nodes->nodes[j]->type) == nodes)
+        nodes->nodes[count ++] = nodes->nodes[j];
+    }
+
+    doc->num_indexed -= nodes->num_nodes - count;
+    nodes->num_nodes = count;
+  }
+}
+
+
+//
+// 'mmd_nodes_delete()' - Delete a node from an index.
+//
+// Nodes are usually freed from the start (block callback) or end (failed load)
+// of the document, so the index is searched from both ends.
+//
+
+static size_t				// O - Former position of node or number of nodes if not found
+mmd_nodes_delete(_mmd_doc_t   *doc,	// I - Document
+                 _mmd_nodes_t *nodes,	// I - Indexed nodes
+                 mmd_t        *node)	// I - Node
+{
+  mmd_t		**nodeptr = NULL;	// Pointer to node in index
+  size_t	i,			// Index from start
+		j;			// Index from end
+
+
+  for (i = 0, j = nodes->num_nodes; i < j && !nodeptr; i ++)
+  {
+    if (nodes->nodes[i] == node)
+      nodeptr = nodes->nodes + i;
+    else if (nodes->nodes[-- j] == node)
+      nodeptr = nodes->nodes + j;
+  }
+
+  if (!nodeptr)
+    return (nodes->num_nodes);
+
+  nodes->num_nodes --;
+  doc->num_indexed --;
+
+  memmove(nodeptr, nodeptr + 1, (size_t)(nodes->nodes + nodes->num_nodes - nodeptr) * sizeof(mmd_t *));
+
+  return ((size_t)(nodeptr - nodes->nodes));
+}
+
+
+//
+// 'mmd_nodes_find()' - Find the index for a node type.
+//
+
+static _mmd_nodes_t *			// O - Indexed nodes or `NULL` if not indexed
+mmd_nodes_find(_mmd_doc_t *doc,		// I - Document
+               mmd_type_t type)		// I - Node type
+{
+  switch (type)
+  {
+    case MMD_TYPE_HEADING_1 :
+    case MMD_TYPE_HEADING_2 :
+    case MMD_TYPE_HEADING_3 :
+    case MMD_TYPE_HEADING_4 :
+    case MMD_TYPE_HEADING_5 :
+    case MMD_TYPE_HEADING_6 :
+        return (doc->nodes + type - MMD_TYPE_HEADING_1);
+    case MMD_TYPE_CODE_BLOCK :
+        return (doc->nodes + 6);
+    case MMD_TYPE_LINKED_TEXT :
+        return (doc->nodes + 7);
+    case MMD_TYPE_IMAGE :
+        return (doc->nodes + 8);
+    case MMD_TYPE_CHECKBOX :
+        return (doc->nodes + 9);
+    default :
+        return (NULL);
+  }
+}
+
+
+//
+// 'mmd_nodes_rebuild()' - Rebuild the index in document order.
+//
+
+static void
+mmd_nodes_rebuild(_mmd_doc_t *doc)	// I - Document
+{
+  size_t	i,			// Looping var
+		depth = 0;		// Depth of current node
+  mmd_t		*current;		// Current node
+
+
+  for (i = 0; i < MMD_NODES_MAX; i ++)
+    doc->nodes[i].num_nodes = 0;
+
+  doc->num_indexed    = 0;
+  doc->unsorted_nodes = false;
+  doc->num_headings   = 0;
+
+  for (current = &doc->node; current; current = mmd_walk(&doc->node, current, &depth))
+    mmd_nodes_add(doc, current);
+}
+
+
+//
+// 'mmd_nodes_remove()' - Remove a node from the index of its type and the
+//                        outline.
+//
+
+static void
+mmd_nodes_remove(_mmd_doc_t *doc,	// I - Document
+                 mmd_t      *node)	// I - Node
+{
+  _mmd_nodes_t	*nodes;			// Indexed nodes
+  size_t	pos;			// Position in outline
+
+
+  if (node->type >= MMD_TYPE_HEADING_1 && node->type <= MMD_TYPE_HEADING_6)
+  {
+    // Headings after this one need their outline entries updated...
+    if ((pos = mmd_nodes_delete(doc, doc->nodes + MMD_NODES_OUTLINE, node)) < doc->num_headings)
+      doc->num_headings = pos;
+  }
+
+  if ((nodes = mmd_nodes_find(doc, node->type)) != NULL)
+    mmd_nodes_delete(doc, nodes, node);
+}
+
+
+//
+// 'mmd_parallel_line()' - Check whether a line can start a new part of a load.
+//
+// Parts start at an unindented line of text following an empty line outside of
+// any code fence or metadata, which always begins a new top-level paragraph,
+// heading, or table.  Code fences are only approximated here, so callers check
+// that each part really ended outside of a code fence.
+//
+
+static bool				// O - `true` if a part can start here
+mmd_parallel_line(_mmd_split_t *split,	// I - Split state
+                  const char   *ptr,	// I - Start of line
+                  const char   *next)	// I - End of line
+{
+  bool		ret,			// Return value
+		quoted = false;		// Is the line in a block quote?
+  const char	*temp;			// Temporary pointer
+  size_t	len;			// Length of fence
+
+
+  ret = split->blank && !split->fence && !split->in_metadata && ptr < next && (isalpha(*ptr & 255) || (*ptr & 0x80));
+
+  // Check for an empty line, since lines containing whitespace can be
+  // continuations of list items...
+  split->blank = ptr < next && (*ptr == '\n' || (*ptr == '\r' && (ptr + 1) < next && ptr[1] == '\n'));
+
+  for (temp = ptr; temp < next && (*temp == ' ' || *temp == '\t'); temp ++);
+
+  // Metadata starts with "---" before any other text and ends with a "---" or
+  // "..." line...
+  if (split->in_metadata)
+  {
+    if ((next - temp) >= 3 && (!memcmp(temp, "---", 3) || !memcmp(temp, "...", 3)))
+      split->in_metadata = false;
+
+    return (false);
+  }
+  else if (split->metadata && temp < next && *temp != '\n' && *temp != '\r')
+  {
+    split->metadata = false;
+
+    if ((next - temp) >= 3 && !memcmp(temp, "---", 3))
+    {
+      split->in_metadata = true;
+      return (false);
+    }
+  }
+
+  // A code fence in a block quote ends with the block quote...
+  if (split->fence && split->quoted && (temp >= next || *temp != '>'))
+    split->fence = '\0';
+
+  // Check for a code fence, possibly in a block quote...
+  for (; temp < next && (*temp == ' ' || *temp == '\t' || *temp == '>'); temp ++)
+  {
+    if (*temp == '>')
+      quoted = true;
+  }
+
+  if (temp < next && (*temp == '`' || *temp == '~'))
+  {
+    for (len = 1; (temp + len) < next && temp[len] == *temp; len ++);
+
+    if (len >= 3)
+    {
+      if (!split->fence)
+      {
+        split->fence    = *temp;
+        split->fencelen = len;
+        split->quoted   = quoted;
+      }
+      else if (*temp == split->fence && len >= split->fencelen)
+      {
+        split->fence = '\0';
+      }
+    }
+  }
+
+  return (ret);
+}
+
+
+//
+// 'mmd_parallel_load()' - Load one part of a parallel load.
+//
+
+static void
+mmd_parallel_load(_mmd_part_t *part)	// I - Part
+{
+  _mmd_membuf_t	buf;			// Memory buffer
+
+
+  // Use the allocator of the document being loaded, since the memory of the
+  // part is moved to it...
+  if ((part->doc = mmd_realloc(part->parent, NULL, sizeof(_mmd_doc_t))) == NULL)
+    return;
+
+  memset(part->doc, 0, sizeof(_mmd_doc_t));
+
+  part->doc->node.type   = MMD_TYPE_DOCUMENT;
+  part->doc->defer_refs  = true;
+  part->doc->no_metadata = part->no_metadata;
+  part->doc->alloc_cb    = part->parent->alloc_cb;
+  part->doc->alloc_data  = part->parent->alloc_data;
+  part->doc->strings     = part->parent->strings;
+
+  buf.ptr = part->start;
+  buf.end = part->end;
+
+  mmdLoadIO(&part->doc->node, (mmd_iocb_t)mmd_iocb_buffer, &buf);
+}
+
+
+//
+// 'mmd_parallel_merge()' - Move the nodes, memory, and references of a part.
+//
+
+static void
+mmd_parallel_merge(_mmd_doc_t *doc,	// I - Document
+                   _mmd_doc_t *partdoc)	// I - Document for part
+{
+  mmd_t		*node;			// Current node
+  _mmd_chunk_t	*chunk;			// Last chunk of part
+  _mmd_defer_t	*deferred;		// Current deferred reference
+  size_t	i;			// Looping var
+
+
+  // Move the top-level nodes...
+  if ((node = partdoc->node.first_child) != NULL)
+  {
+    if (doc->root->last_child)
+      doc->root->last_child->next_sibling = node;
+    else
+      doc->root->first_child = node;
+
+    node->prev_sibling     = doc->root->last_child;
+    doc->root->last_child  = partdoc->node.last_child;
+
+    if (doc->block_cb && !doc->block_next)
+      doc->block_next = node;
+
+    for (; node; node = node->next_sibling)
+      node->parent = doc->root;
+  }
+
+  // Move the memory chunks behind the current chunk...
+  if ((chunk = partdoc->chunks) != NULL)
+  {
+    while (chunk->next)
+      chunk = chunk->next;
+
+    if (doc->chunks)
+    {
+      chunk->next       = doc->chunks->next;
+      doc->chunks->next = partdoc->chunks;
+    }
+    else
+    {
+      doc->chunks = partdoc->chunks;
+    }
+
+    partdoc->chunks = NULL;
+  }
+
+  // Add the freed nodes...
+  if ((node = partdoc->free_nodes) != NULL)
+  {
+    while (node->first_child)
+      node = node->first_child;
+
+    node->first_child = doc->free_nodes;
+    doc->free_nodes   = partdoc->free_nodes;
+  }
+
+  doc->num_nodes += partdoc->num_nodes;
+  doc->num_lazy  += partdoc->num_lazy;
+
+  // Add the indexed nodes...
+  for (i = 0; i < MMD_NODES_MAX; i ++)
+  {
+    _mmd_nodes_t *nodes = doc->nodes + i,
+					// Indexed nodes
+		*partnodes = partdoc->nodes + i;
+					// Indexed nodes of part
+
+    if (partnodes->num_nodes == 0)
+      continue;
+
+    if ((nodes->num_nodes + partnodes->num_nodes) > nodes->alloc_nodes)
+    {
+      mmd_t	**temp;			// New nodes
+      size_t	alloc_nodes = nodes->num_nodes + partnodes->num_nodes + 64;
+					// New allocation size
+
+      if ((temp = mmd_realloc(doc, nodes->nodes, alloc_nodes * sizeof(mmd_t *))) == NULL)
+      {
+        doc->error = ENOMEM;
+        break;
+      }
+
+      nodes->nodes       = temp;
+      nodes->alloc_nodes = alloc_nodes;
+    }
+
+    memcpy(nodes->nodes + nodes->num_nodes, partnodes->nodes, partnodes->num_nodes * sizeof(mmd_t *));
+    nodes->num_nodes += partnodes->num_nodes;
+    doc->num_indexed += partnodes->num_nodes;
+  }
+
+  if (partdoc->unsorted_nodes || (partdoc->num_indexed && doc->num_lazy))
+    doc->unsorted_nodes = true;
+
+  // Add the statistics...
+  doc->stats.bytes         += partdoc->stats.bytes;
+  doc->stats.lines         += partdoc->stats.lines;
+  doc->stats.refills       += partdoc->stats.refills;
+  doc->stats.continuations += partdoc->stats.continuations;
+  doc->stats.pending       += partdoc->stats.pending;
+  doc->stats.allocs        += partdoc->stats.allocs;
+  doc->stats.alloc_bytes   += partdoc->stats.alloc_bytes;
+  doc->stats.chunks        += partdoc->stats.chunks;
+  doc->stats.block_time    += partdoc->stats.block_time;
+  doc->stats.inline_time   += partdoc->stats.inline_time;
+
+  for (i = 0; i <= MMD_TYPE_CHECKBOX; i ++)
+    doc->stats.nodes[i] += partdoc->stats.nodes[i];
+
+  if (mmd_limits[MMD_LIMIT_NODES] && doc->num_nodes > mmd_limits[MMD_LIMIT_NODES])
+  {
+    DEBUG_printf("mmd_parallel_merge: Too many nodes (%lu).\n", (unsigned long)doc->num_nodes);
+    doc->error = EFBIG;
+  }
+
+  // Add the references in the order they were seen...
+  for (i = partdoc->num_deferred, deferred = partdoc->deferred; i > 0; i --, deferred ++)
+    mmd_ref_add(doc, deferred->node, deferred->name, deferred->url, deferred->title);
+
+  partdoc->node.first_child = partdoc->node.last_child = NULL;
+
+  mmd_free(&partdoc->node);
+}
+
+
+//
+// 'mmd_parallel_split()' - Split a buffer into parts for a parallel load.
+//
+
+static size_t				// O - Number of parts
+mmd_parallel_split(
+    const char  *buffer,		// I - Buffer
+    size_t      bytes,			// I - Number of bytes in buffer
+    size_t      max_parts,		// I - Maximum number of parts
+    _mmd_part_t *parts,			// I - Parts
+    bool        metadata)		// I - Can the buffer start with metadata?
+{
+  const char	*ptr,			// Pointer to current line
+		*next,			// Pointer to next line
+		*end = buffer + bytes;	// End of buffer
+  size_t	num_parts = 1,		// Number of parts
+		target = bytes / max_parts;
+					// Target offset for next part
+  _mmd_split_t	split;			// Split state
+
+
+  memset(&split, 0, sizeof(split));
+
+  split.metadata = metadata;
+  parts[0].start = buffer;
+
+  for (ptr = buffer; ptr < end; ptr = next)
+  {
+    if ((next = memchr(ptr, '\n', (size_t)(end - ptr))) != NULL)
+      next ++;
+    else
+      next = end;
+
+    if (mmd_parallel_line(&split, ptr, next) && (size_t)(ptr - buffer) >= target)
+    {
+      // Start a new part here...
+      parts[num_parts - 1].end = ptr;
+      parts[num_parts].start   = ptr;
+      num_parts ++;
+
+      if (num_parts >= max_parts)
+        break;
+
+      target = (size_t)(ptr - buffer) + (size_t)(end - ptr) / (max_parts - num_parts + 1);
+    }
+  }
+
+  parts[num_parts - 1].end = end;
+
+  DEBUG_printf("mmd_parallel_split: num_parts=%lu\n", (unsigned long)num_parts);
+
+  return (num_parts);
+}
+
+
+//
+// 'mmd_parallel_thread()' - Load a part of a parallel load in a thread.
+//
+
+#if _WIN32
+static DWORD WINAPI			// O - Exit status
+mmd_parallel_thread(LPVOID data)	// I - Part
+{
+  mmd_parallel_load((_mmd_part_t *)data);
+
+  return (0);
+}
+#else
+static void *				// O - Exit status
+mmd_parallel_thread(void *data)		// I - Part
+{
+  mmd_parallel_load((_mmd_part_t *)data);
+
+  return (NULL);
+}
+#endif // _WIN32
+
+
+//
+// 'mmd_parse_inline()' - Parse inline formatting.
+//
+
+static void
+mmd_parse_inline(_mmd_doc_t *doc,	// I - Document
+		 mmd_t	    *parent,	// I - Parent node
+		 char	    *lineptr)	// I - Pointer into line
+{
+  mmd_t		*node;			// New node
+  mmd_type_t	type;			// Current node type
+  int		whitespace;		// Whitespace precedes?
+  bool		escaped = false;	// Escaped characters in text?
+  char		*text,			// Text fragment in line
+		*title,			// Link title
+		*url,			// URL in link
+		*refname;		// Reference name
+  const char	*delim = NULL;		// Delimiter
+  size_t	delimlen = 0;		// Length of delimiter
+  _mmd_index_t	index;			// Closing delimiter index
+
+
+  if (!parent)
+    return;
+
+  whitespace  = parent->last_child != NULL;
+  index.start = NULL;
+
+  for (text = NULL, type = MMD_TYPE_NORMAL_TEXT; *lineptr; lineptr ++)
+  {
+    DEBUG2_printf("mmd_parse_inline: lineptr=%p(\"%s\"), type=%d, text=%p, whitespace=%d\n", lineptr, lineptr, type, text, whitespace);
+
+    if (isspace(*lineptr & 255) && type != MMD_TYPE_CODE_TEXT)
+    {
+      if (text)
+      {
+	*lineptr = '\0';
+
+	if (escaped)
+	  mmd_unescape(text);
+
+	mmd_add(doc, parent, type, whitespace, text, NULL);
+
+	text	= NULL;
+	escaped = false;
+      }
+
+      if (!strncmp(lineptr + 1, " \n", 2) && lineptr[3])
+      {
+	DEBUG2_printf("mmd_parse_inline: Adding hard break to %p(%d)\n", parent, parent->type);
+	mmd_add(doc, parent, MMD_TYPE_HARD_BREAK, 0, NULL, NULL);
 	lineptr += 2;
 	whitespace = 0;
       }
-      else
+      else
+      {
+	whitespace = 1;
+      }
+    }
+    else if (*lineptr == '!' && lineptr[1] == '[' && type != MMD_TYPE_CODE_TEXT)
+    {
+      // Image...
+      if (text)
+      {
+        *lineptr = '\0';
+
+	if (escaped)
+	  mmd_unescape(text);
+
+	mmd_add(doc, parent, type, whitespace, text, NULL);
+
+	text	   = NULL;
+	escaped	   = false;
+	whitespace = 0;
+      }
+
+      lineptr = mmd_parse_link(doc, lineptr + 1, &text, &url, NULL, &refname);
+
+      if (url || refname)
+      {
+	node = mmd_add(doc, parent, MMD_TYPE_IMAGE, whitespace, text, url);
+
+	if (refname)
+	  mmd_ref_add(doc, node, refname, NULL, NULL);
+      }
+
+      if (!*lineptr)
+	return;
+
+      text = url = NULL;
+      whitespace = 0;
+      lineptr --;
+    }
+    else if (*lineptr == '[' && type != MMD_TYPE_CODE_TEXT)
+    {
+      // Link or checkbox...
+      if (text)
+      {
+        *lineptr = '\0';
+
+	if (escaped)
+	  mmd_unescape(text);
+
+	mmd_add(doc, parent, type, whitespace, text, NULL);
+
+	text	   = NULL;
+	escaped	   = false;
+	whitespace = 0;
+      }
+
+      // The "[" may have been replaced by a nul above...
+      if ((mmd_options & MMD_OPTION_TASKS) && (!strncmp(lineptr + 1, " ]", 2) || !strncmp(lineptr + 1, "x]", 2) || !strncmp(lineptr + 1, "X]", 2)))
+      {
+        // Checkbox
+        mmd_add(doc, parent, MMD_TYPE_CHECKBOX, 0, lineptr[1] == ' ' ? NULL : "x", NULL);
+        lineptr += 2;
+      }
+      else
+      {
+        // Link
+	lineptr = mmd_parse_link(doc, lineptr, &text, &url, &title, &refname);
+
+	if (text)
+	{
+	  char *end = text + strlen(text) - 1;
+					// End of text fragment
+
+	  if (*text == '`' && *end == '`' && end != text)
+	  {
+	    // Code text
+	    text ++;
+	    if (end > text && *end == '`')
+	      *end = '\0';
+
+	    node = mmd_add(doc, parent, MMD_TYPE_CODE_TEXT, whitespace, text, url);
+	  }
+	  else if (*text == '*' && *end == '*' && end > text)
+	  {
+	    // Emphasized or strong text
+	    text ++;
+	    if (*text == '*' && (end - 1) > text && end[-1] == '*')
+	    {
+	      text ++;
+	      end[-1] = '\0';
+	      node    = mmd_add(doc, parent, MMD_TYPE_STRONG_TEXT, whitespace, text, url);
+	    }
+	    else
+	    {
+	      *end = '\0';
+	      node = mmd_add(doc, parent, MMD_TYPE_EMPHASIZED_TEXT, whitespace, text, url);
+            }
+	  }
+	  else if (type == MMD_TYPE_NORMAL_TEXT)
+	  {
+	    // Plain linked text...
+	    node = mmd_add(doc, parent, MMD_TYPE_LINKED_TEXT, whitespace, text, url);
+	  }
+	  else
+	  {
+	    // Preserve style of linked text...
+	    node = mmd_add(doc, parent, type, whitespace, text, url);
+	  }
+
+	  if (title && node)
+	    node->extra = mmd_strdup(doc, title);
+	}
+	else
+	{
+	  // No text, no node...
+	  node = NULL;
+	}
+
+	DEBUG2_printf("mmd_parse_inline: text=\"%s\", refname=\"%s\", node=%p\n", text, refname, node);
+
+	if (refname && node)
+	  mmd_ref_add(doc, node, refname, NULL, title);
+
+	if (!*lineptr)
+	  return;
+
+	text = url = NULL;
+	whitespace = 0;
+	lineptr --;
+      }
+    }
+    else if (*lineptr == '<' && type != MMD_TYPE_CODE_TEXT && mmd_find_delim(doc, &index, lineptr, ">", 1))
+    {
+      // Autolink...
+      *lineptr++ = '\0';
+
+      if (text)
+      {
+	if (escaped)
+	  mmd_unescape(text);
+
+	mmd_add(doc, parent, type, whitespace, text, NULL);
+
+	text	   = NULL;
+	escaped	   = false;
+	whitespace = 0;
+      }
+
+      url      = lineptr;
+      lineptr  = strchr(lineptr, '>');
+      *lineptr = '\0';
+
+      mmd_add(doc, parent, MMD_TYPE_LINKED_TEXT, whitespace, url, url);
+
+      text = url = NULL;
+      whitespace = 0;
+    }
+    else if ((*lineptr == '*' || *lineptr == '_') && (!text || ispunct(lineptr[-1] & 255) || type != MMD_TYPE_NORMAL_TEXT) && type != MMD_TYPE_CODE_TEXT)
+    {
+      const char *end;			// End delimiter
+
+      if (type != MMD_TYPE_NORMAL_TEXT || !delim)
+      {
+	if (!strncmp(lineptr, "**", 2))
+	  delim = "**";
+	else if (!strncmp(lineptr, "__", 2))
+	  delim = "__";
+	else if (*lineptr == '*')
+	  delim = "*";
+	else
+	  delim = "_";
+
+	delimlen = strlen(delim);
+      }
+
+      if (type == MMD_TYPE_NORMAL_TEXT && delim && ((end = mmd_find_delim(doc, &index, lineptr, delim, delimlen)) == NULL || end == (lineptr + delimlen) || isspace(end[-1] & 255)))
+      {
+	if (!text)
+	  text = lineptr;
+
+	delim	 = NULL;
+	delimlen = 0;
+	continue;
+      }
+
+      if (text)
+      {
+	char	save = *lineptr,	// Saved delimiter
+		*inline_end = doc->inline_end;
+					// End of inline text
+
+	*lineptr = '\0';
+
+	if (escaped)
+	  mmd_unescape(text);
+
+	// The delimiter is restored after adding the text, so the node needs a
+	// copy of it...
+	doc->inline_end = text;
+
+	mmd_add(doc, parent, type, whitespace, text, NULL);
+
+	doc->inline_end = inline_end;
+	*lineptr        = save;
+	text	   = NULL;
+	escaped	   = false;
+	whitespace = 0;
+      }
+
+      if (type == MMD_TYPE_NORMAL_TEXT)
+      {
+	if (!strncmp(lineptr, delim, delimlen) && !isspace(lineptr[delimlen] & 255))
+	{
+	  type = delimlen == 2 ? MMD_TYPE_STRONG_TEXT : MMD_TYPE_EMPHASIZED_TEXT;
+	  text = lineptr + delimlen;
+	  lineptr += delimlen - 1;
+	}
+	else
+	{
+	  text = lineptr;
+	}
+      }
+      else if (!strncmp(lineptr, delim, delimlen))
+      {
+	lineptr += delimlen - 1;
+	type = MMD_TYPE_NORMAL_TEXT;
+
+	delim	 = NULL;
+	delimlen = 0;
+      }
+    }
+    else if (lineptr[0] == '~' && lineptr[1] == '~' && type != MMD_TYPE_CODE_TEXT)
+    {
+      if (text)
+      {
+	*lineptr = '\0';
+
+	if (escaped)
+	  mmd_unescape(text);
+
+	mmd_add(doc, parent, type, whitespace, text, NULL);
+
+	text	   = NULL;
+	escaped	   = false;
+	whitespace = 0;
+      }
+
+      if (!isspace(lineptr[2] & 255) && type == MMD_TYPE_NORMAL_TEXT)
+      {
+	type = MMD_TYPE_STRUCK_TEXT;
+	text = lineptr + 2;
+	lineptr ++;
+      }
+      else
+      {
+	lineptr ++;
+	type = MMD_TYPE_NORMAL_TEXT;
+      }
+    }
+    else if (*lineptr == '`' && (type != MMD_TYPE_CODE_TEXT || lineptr[-1] != '\\'))
+    {
+      if (lineptr[1] == '`')
+      {
+	if (lineptr[2] == '`')
+	{
+	  delim    = "```";
+	  delimlen = 3;
+	}
+	else
+	{
+	  delim    = "``";
+	  delimlen = 2;
+	}
+      }
+      else
+      {
+	delim	 = "`";
+	delimlen = 1;
+      }
+
+      if (type != MMD_TYPE_CODE_TEXT && !mmd_find_delim(doc, &index, lineptr, delim, delimlen))
+      {
+	if (!text)
+	  text = lineptr;
+
+	delim	 = NULL;
+	delimlen = 0;
+	continue;
+      }
+
+      if (text)
+      {
+	char	*textptr = lineptr;	// End of text
+
+	DEBUG2_printf("mmd_parse_inline: text=\"%s\"\n", text);
+
+	while (textptr > text && isspace(textptr[-1] & 255))
+	  textptr --;
+
+	*textptr = '\0';
+
+	if (type == MMD_TYPE_CODE_TEXT)
+	  lineptr += delimlen - 1;
+
+	if (escaped)
+	  mmd_unescape(text);
+
+	if (type == MMD_TYPE_CODE_TEXT)
+	{
+	  if (whitespace && !*text)
+	  {
+	    mmd_add(doc, parent, type, 0, " ", NULL);
+	    whitespace = 0;
+	  }
+	}
+
+	mmd_add(doc, parent, type, whitespace, text, NULL);
+
+	text	   = NULL;
+	escaped	   = false;
+	whitespace = 0;
+      }
+
+      if (type == MMD_TYPE_CODE_TEXT)
+      {
+	DEBUG2_puts("mmd_parse_inline: Reverting to normal text.\n");
+
+	type	 = MMD_TYPE_NORMAL_TEXT;
+	delim	 = NULL;
+	delimlen = 0;
+      }
+      else
+      {
+	type	= MMD_TYPE_CODE_TEXT;
+	lineptr += delimlen - 1;
+
+	while (isspace(lineptr[1] & 255))
+	  lineptr ++;
+
+	text = lineptr + 1;
+      }
+    }
+    else if (!strncmp(lineptr, "\\\n", 2))
+    {
+      // Hard break
+      *lineptr++ = '\0';
+
+      if (text)
+      {
+        if (escaped)
+          mmd_unescape(text);
+
+        mmd_add(doc, parent, type, whitespace, text, NULL);
+
+        text       = NULL;
+        escaped    = false;
+        whitespace = false;
+      }
+
+      mmd_add(doc, parent, MMD_TYPE_HARD_BREAK, false, NULL, NULL);
+    }
+    else if (!text)
+    {
+      if (*lineptr == '\\' && ispunct(lineptr[1] & 255) && type != MMD_TYPE_CODE_TEXT)
+      {
+        // Escaped character, remove the "\" when the text is added...
+        text	= lineptr ++;
+        escaped = true;
+      }
+      else
+      {
+        text = lineptr;
+      }
+    }
+    else if (*lineptr == '\\' && ispunct(lineptr[1] & 255) && type != MMD_TYPE_CODE_TEXT)
+    {
+      // Escaped character, remove the "\" when the text is added...
+      lineptr ++;
+      escaped = true;
+    }
+  }
+
+  if (text)
+  {
+    DEBUG_puts("mms_parse_inline: Adding text at end.\n");
+
+    if (escaped)
+      mmd_unescape(text);
+
+    mmd_add(doc, parent, type, whitespace, text, NULL);
+  }
+}
+
+
+//
+// 'mmd_parse_lazy()' - Parse the saved inline text of a block.
+//
+
+static void
+mmd_parse_lazy(_mmd_doc_t *doc,		// I - Document
+               mmd_t      *node)	// I - Block node
+{
+  char		*segment,		// Current segment of text
+		*next;			// Next segment of text
+  int		error;			// Saved error code
+  double	start;			// Start time
+
+
+  if (!doc || !node->lazy)
+    return;
+
+  DEBUG2_printf("mmd_parse_lazy(doc=%p, node=%p(%s))\n", doc, node, mmd_type_string(node->type));
+
+  segment    = node->text;
+  node->text = NULL;
+  node->lazy = false;
+  doc->num_lazy --;
+
+  // Parse limits are enforced here too, but any error only truncates the text
+  // of this block...
+  error      = doc->error;
+  doc->error = 0;
+
+  start = mmd_time();
+
+  for (; *segment; segment = next)
+  {
+    // Find the next segment before the parser modifies this one...
+    next = segment + strlen(segment) + 1;
+
+    doc->inline_start = segment;
+    doc->inline_end   = next;
+
+    mmd_parse_inline(doc, node, segment);
+  }
+
+  doc->inline_start      = doc->inline_end = NULL;
+  doc->stats.inline_time += mmd_time() - start;
+
+  // Unresolved references are converted at the end of a load...
+  if (!doc->loading)
+    mmd_ref_clear(doc);
+
+  doc->error = error;
+}
+
+
+//
+// 'mmd_parse_link()' - Parse a link.
+//
+
+static char *				// O - End of link text
+mmd_parse_link(_mmd_doc_t *doc,		// I - Document
+	       char	  *lineptr,	// I - Pointer into line
+	       char	  **text,	// O - Text
+	       char	  **url,	// O - URL
+	       char	  **title,	// O - Title, if any
+	       char	  **refname)	// O - Reference name
+{
+  char	*ptr;				// Output pointer
+
+
+  lineptr ++; // skip "["
+
+  *text	   = lineptr;
+  *url	   = NULL;
+  *refname = NULL;
+
+  if (title)
+    *title = NULL;
+
+  while (*lineptr && *lineptr != ']')
+  {
+    if (*lineptr == '\"' || *lineptr == '\'')
+    {
+      char quote = *lineptr++;
+
+      while (*lineptr && *lineptr != quote)
+	lineptr ++;
+
+      if (!*lineptr)
+	return (lineptr);
+    }
+
+    lineptr ++;
+  }
+
+  if (!*lineptr)
+    return (lineptr);
+
+  *lineptr++ = '\0';
+
+  if (*lineptr == '(')
+  {
+    // Get URL...
+    lineptr ++;
+    *url = ptr = lineptr;
+
+    while (*lineptr && *lineptr != ')')
+    {
+      if (isspace(*lineptr & 255))
+      {
+	*lineptr = '\0';
+      }
+      else if (*lineptr == '\\' && lineptr[1])
       {
-	whitespace = 1;
+        if (lineptr[1] == ')')
+        {
+	  // Remove "\"
+	  lineptr ++;
+	}
+	else
+	{
+	  // Keep "\"
+	  *ptr++ = *lineptr++;
+	}
+      }
+      else if (*lineptr == '\"' || *lineptr == '\'')
+      {
+	char quote = *lineptr;
+
+	*ptr++ = *lineptr++;
+
+	if (title)
+	  *title = ptr;
+
+	while (*lineptr && *lineptr != quote)
+	{
+	  if (*lineptr == '\\' && lineptr[1])
+	  {
+	    // Remove "\"
+	    lineptr ++;
+	  }
+
+	  *ptr++ = *lineptr++;
+	}
+
+	if (!*lineptr)
+	{
+	  *ptr = '\0';
+	  return (lineptr);
+	}
+	else if (title)
+	{
+	  *lineptr = '\0';
+	}
       }
+
+      *ptr++ = *lineptr++;
     }
-    else if (*lineptr == '!' && lineptr[1] == '[' && type != MMD_TYPE_CODE_TEXT)
+
+    if (*lineptr)
+      lineptr ++;
+
+    *ptr = '\0';
+  }
+  else if (*lineptr == '[')
+  {
+    // Get reference...
+    lineptr ++;
+    *refname = ptr = lineptr;
+
+    while (*lineptr && *lineptr != ']')
     {
-      // Image...
-      if (text)
+      if (isspace(*lineptr & 255))
+      {
+	*lineptr = '\0';
+      }
+      else if (*lineptr == '\\' && lineptr[1])
+      {
+        if (lineptr[1] == ']')
+        {
+	  // Remove "\"
+	  lineptr ++;
+	}
+	else
+	{
+	  // Keep "\"
+	  *ptr++ = *lineptr++;
+	}
+      }
+      else if (*lineptr == '\"' || *lineptr == '\'')
       {
-	mmd_add(parent, type, whitespace, text, NULL);
+	char quote = *lineptr;
 
-	text	   = NULL;
-	whitespace = 0;
+	*ptr++ = *lineptr++;
+
+	if (title)
+	  *title = ptr;
+
+	while (*lineptr && *lineptr != quote)
+	  *ptr++ = *lineptr++;
+
+	if (!*lineptr)
+	{
+	  *ptr = '\0';
+	  return (lineptr);
+	}
+	else
+	{
+	  *lineptr = '\0';
+	}
       }
 
-      lineptr = mmd_parse_link(doc, lineptr + 1, &text, &url, NULL, &refname);
+      *ptr++ = *lineptr++;
+    }
+
+    if (*lineptr)
+      lineptr ++;
+
+    *ptr = '\0';
+
+    if (!**refname)
+      *refname = *text;
+  }
+  else if (*lineptr == ':')
+  {
+    // Get reference definition...
+    lineptr ++;
+    while (*lineptr && isspace(*lineptr & 255))
+      lineptr ++;
+
+    *url = ptr = lineptr;
+
+    while (*lineptr && !isspace(*lineptr & 255))
+    {
+      if (*lineptr == '\\' && lineptr[1])
+      {
+        // Remove "\"
+	lineptr ++;
+      }
+
+      *ptr++ = *lineptr++;
+    }
+
+    if (*lineptr)
+      lineptr ++;
+
+    *ptr = '\0';
+
+    while (*lineptr && isspace(*lineptr & 255))
+      lineptr ++;
+
+    if (*lineptr == '\"' || *lineptr == '\'')
+    {
+      char quote = *lineptr++;
+
+      if (title)
+	*title = lineptr;
+
+      for (ptr = lineptr; *lineptr && *lineptr != quote; *ptr++ = *lineptr++)
+      {
+	if (*lineptr == '\\' && lineptr[1])
+	{
+	  // Remove "\"
+	  lineptr ++;
+	}
+      }
+
+      if (!*lineptr)
+      {
+        *ptr = '\0';
+	return (lineptr);
+      }
+
+      *ptr = *lineptr = '\0';
+    }
+
+    mmd_ref_add(doc, NULL, *text, *url, title ? *title : NULL);
+
+    *text = NULL;
+    *url  = NULL;
+
+    if (title)
+      *title = NULL;
+  }
+  else
+  {
+    // Shortcut reference...
+    *refname = *text;
+  }
+
+  return (lineptr);
+}
+
+
+//
+// 'mmd_parser_load()' - Load the text at the start of an incremental load.
+//
+
+static bool				// O - `true` if loaded, `false` otherwise
+mmd_parser_load(mmd_parser_t *parser,	// I - Parser
+                size_t       bytes,	// I - Number of bytes to load
+                bool         finish)	// I - Last text for the load?
+{
+  _mmd_part_t	part;			// Part to load
+  _mmd_doc_t	*partdoc;		// Document for part
+
+
+  DEBUG_printf("mmd_parser_load: bytes=%lu, finish=%s\n", (unsigned long)bytes, finish ? "true" : "false");
+
+  memset(&part, 0, sizeof(part));
+
+  part.start       = parser->buffer;
+  part.end         = parser->buffer + bytes;
+  part.parent      = parser->doc;
+  part.no_metadata = !parser->empty;
+
+  mmd_parallel_load(&part);
+
+  if ((partdoc = part.doc) == NULL)
+  {
+    parser->doc->error = ENOMEM;
+    return (false);
+  }
+  else if (partdoc->error)
+  {
+    parser->doc->error = partdoc->error;
+    mmd_free(&partdoc->node);
+    return (false);
+  }
+  else if (!finish && (partdoc->in_fence || partdoc->in_metadata || (parser->empty && !partdoc->node.first_child)))
+  {
+    // Not a safe place to split...
+    mmd_free(&partdoc->node);
+    return (false);
+  }
 
-      if (url || refname)
-      {
-	node = mmd_add(parent, MMD_TYPE_IMAGE, whitespace, text, url);
+  if (partdoc->node.first_child)
+    parser->empty = false;
 
-	if (refname)
-	  mmd_ref_add(doc, node, refname, NULL, NULL);
-      }
+  mmd_parallel_merge(parser->doc, partdoc);
 
-      if (!*lineptr)
-	return;
+  // Each part ends before a new top-level block, so all of its blocks are
+  // complete...
+  if (parser->doc->block_cb)
+    mmd_block_done(parser->doc, true);
 
-      text = url = NULL;
-      whitespace = 0;
-      lineptr --;
-    }
-    else if (*lineptr == '[' && type != MMD_TYPE_CODE_TEXT)
-    {
-      // Link or checkbox...
-      if (text)
-      {
-        *lineptr = '\0';
-	mmd_add(parent, type, whitespace, text, NULL);
-	*lineptr = '[';
+  // Remove the loaded text from the buffer...
+  parser->used -= bytes;
+  memmove(parser->buffer, parser->buffer + bytes, parser->used);
 
-	text	   = NULL;
-	whitespace = 0;
-      }
+  parser->scanned   -= bytes;
+  parser->split_at  = 0;
+  parser->min_split = 0;
 
-      if ((mmd_options & MMD_OPTION_TASKS) && (!strncmp(lineptr, "[ ]", 3) || !strncmp(lineptr, "[x]", 3) || !strncmp(lineptr, "[X]", 3)))
-      {
-        // Checkbox
-        mmd_add(parent, MMD_TYPE_CHECKBOX, 0, lineptr[1] == ' ' ? NULL : "x", NULL);
-        lineptr += 2;
-      }
-      else
-      {
-        // Link
-	lineptr = mmd_parse_link(doc, lineptr, &text, &url, &title, &refname);
+  return (true);
+}
 
-	if (text)
-	{
-	  char *end = text + strlen(text) - 1;
-					// End of text fragment
 
-	  if (*text == '`' && *end == '`' && end != text)
-	  {
-	    // Code text
-	    text ++;
-	    if (end > text && *end == '`')
-	      *end = '\0';
+//
+// 'mmd_realloc()' - Allocate or reallocate memory using a document's allocator.
+//
+// Memory is allocated using the document's allocator or, when there is no
+// document, the standard C library.
+//
 
-	    node = mmd_add(parent, MMD_TYPE_CODE_TEXT, whitespace, text, url);
-	  }
-	  else if (*text == '*' && *end == '*' && end > text)
-	  {
-	    // Emphasized or strong text
-	    text ++;
-	    if (*text == '*' && (end - 1) > text && end[-1] == '*')
-	    {
-	      text ++;
-	      end[-1] = '\0';
-	      node    = mmd_add(parent, MMD_TYPE_STRONG_TEXT, whitespace, text, url);
-	    }
-	    else
-	    {
-	      *end = '\0';
-	      node = mmd_add(parent, MMD_TYPE_EMPHASIZED_TEXT, whitespace, text, url);
-            }
-	  }
-	  else if (type == MMD_TYPE_NORMAL_TEXT)
-	  {
-	    // Plain linked text...
-	    node = mmd_add(parent, MMD_TYPE_LINKED_TEXT, whitespace, text, url);
-	  }
-	  else
-	  {
-	    // Preserve style of linked text...
-	    node = mmd_add(parent, type, whitespace, text, url);
-	  }
+static void *				// O - Memory or `NULL` on error
+mmd_realloc(_mmd_doc_t *doc,		// I - Document or `NULL` for the standard C library
+            void       *ptr,		// I - Memory to reallocate or `NULL` to allocate
+            size_t     bytes)		// I - Number of bytes or `0` to free
+{
+  if (doc && doc->alloc_cb)
+    return ((doc->alloc_cb)(doc->alloc_data, ptr, bytes));
 
-	  if (title)
-	    node->extra = strdup(title);
-	}
-	else
-	{
-	  // No text, no node...
-	  node = NULL;
-	}
+  if (bytes == 0)
+  {
+    free(ptr);
+    return (NULL);
+  }
 
-	DEBUG2_printf("mmd_parse_inline: text=\"%s\", refname=\"%s\", node=%p\n", text, refname, node);
+  return (realloc(ptr, bytes));
+}
 
-	if (refname && node)
-	  mmd_ref_add(doc, node, refname, NULL, title);
 
-	if (!*lineptr)
-	  return;
+//
+// 'mmd_read_buffer()' - Fill the file buffer with more data from a file.
+//
 
-	text = url = NULL;
-	whitespace = 0;
-	lineptr --;
-      }
-    }
-    else if (*lineptr == '<' && type != MMD_TYPE_CODE_TEXT && strchr(lineptr + 1, '>'))
-    {
-      // Autolink...
-      *lineptr++ = '\0';
+static void
+mmd_read_buffer(_mmd_filebuf_t *file)	// I - File buffer
+{
+  size_t	bytes;			// Bytes read
 
-      if (text)
-      {
-	mmd_add(parent, type, whitespace, text, NULL);
 
-	text	   = NULL;
-	whitespace = 0;
-      }
+  if (file->bufptr && file->bufptr > file->buffer)
+  {
+    // Discard previous characters in the buffer.
+    DEBUG2_printf("mmd_read_buffer: before buffer=\"%s\"\n", file->bufptr);
 
-      url      = lineptr;
-      lineptr  = strchr(lineptr, '>');
-      *lineptr = '\0';
+    memmove(file->buffer, file->bufptr, file->bufend - file->bufptr);
+    file->bufend -= (file->bufptr - file->buffer);
+  }
+  else
+  {
+    // Otherwise just clear the buffer...
+    file->bufend = file->buffer;
+  }
 
-      mmd_add(parent, MMD_TYPE_LINKED_TEXT, whitespace, url, url);
+  if (!file->overflow && (bytes = (file->cb)(file->cbdata, file->bufend, sizeof(file->buffer) - (size_t)(file->bufend - file->buffer) - 1)) > 0)
+  {
+    file->bytes += bytes;
+    file->refills ++;
 
-      text = url = NULL;
-      whitespace = 0;
-    }
-    else if ((*lineptr == '*' || *lineptr == '_') && (!text || ispunct(lineptr[-1] & 255) || type != MMD_TYPE_NORMAL_TEXT) && type != MMD_TYPE_CODE_TEXT)
+    if (mmd_limits[MMD_LIMIT_BYTES] && file->bytes > mmd_limits[MMD_LIMIT_BYTES])
     {
-      const char *end;			// End delimiter
+      // Too much input, stop reading...
+      DEBUG_printf("mmd_read_buffer: Too many bytes (%lu).\n", (unsigned long)file->bytes);
+      file->overflow = true;
+    }
+    else
+      file->bufend += bytes;
+  }
 
-      if (type != MMD_TYPE_NORMAL_TEXT || !delim)
-      {
-	if (!strncmp(lineptr, "**", 2))
-	  delim = "**";
-	else if (!strncmp(lineptr, "__", 2))
-	  delim = "__";
-	else if (*lineptr == '*')
-	  delim = "*";
-	else
-	  delim = "_";
+  *(file->bufend) = '\0';
+  file->bufptr    = file->buffer;
 
-	delimlen = strlen(delim);
-      }
+  DEBUG2_printf("mmd_read_buffer: after buffer=\"%s\"\n", file->buffer);
+}
 
-      if (type == MMD_TYPE_NORMAL_TEXT && delim && ((end = strstr(lineptr + delimlen, delim)) == NULL || end == (lineptr + delimlen) || isspace(end[-1] & 255)))
-      {
-	if (!text)
-	  text = lineptr;
 
-	delim	 = NULL;
-	delimlen = 0;
-	continue;
-      }
+//
+// 'mmd_read_line()' - Read a line from a file in a Markdown-aware way.
+//
 
-      if (text)
-      {
-	char save = *lineptr;
+static char *				// O - Pointer to line or `NULL` on EOF
+mmd_read_line(_mmd_filebuf_t *file,	// I - File buffer
+	      char	     *line,	// I - Line buffer
+	      size_t	     linesize)	// I - Size of line buffer
+{
+  int	ch,				// Current character
+	column = 0;			// Current column
+  char	*lineptr = line,		// Pointer into line
+	*lineend = line + linesize - 1; // Pointer to end of buffer
 
-	*lineptr = '\0';
 
-	mmd_add(parent, type, whitespace, text, NULL);
+  // Fill the buffer as needed...
+  if (!file->bufptr || (file->bufptr >= file->bufend) || !strchr(file->bufptr, '\n'))
+    mmd_read_buffer(file);
 
-	*lineptr   = save;
-	text	   = NULL;
-	whitespace = 0;
-      }
+  // Copy a line out of the file buffer...
+  while (file->bufptr < file->bufend)
+  {
+    ch = *(file->bufptr);
+    file->bufptr ++;
 
-      if (type == MMD_TYPE_NORMAL_TEXT)
-      {
-	if (!strncmp(lineptr, delim, delimlen) && !isspace(lineptr[delimlen] & 255))
-	{
-	  type = delimlen == 2 ? MMD_TYPE_STRONG_TEXT : MMD_TYPE_EMPHASIZED_TEXT;
-	  text = lineptr + delimlen;
-	  lineptr += delimlen - 1;
-	}
-	else
-	{
-	  text = lineptr;
-	}
-      }
-      else if (!strncmp(lineptr, delim, delimlen))
+    if (ch == '\t')
+    {
+      // Expand tabs since nobody uses the same tab width and Markdown says
+      // 4 columns per tab...
+      do
       {
-	lineptr += delimlen - 1;
-	type = MMD_TYPE_NORMAL_TEXT;
-
-	delim	 = NULL;
-	delimlen = 0;
+	column ++;
+	if (lineptr < lineend)
+	  *lineptr++ = ' ';
       }
+      while (column  & 3);
     }
-    else if (lineptr[0] == '~' && lineptr[1] == '~' && type != MMD_TYPE_CODE_TEXT)
+    else if (ch != '\r' && lineptr < lineend)
     {
-      if (text)
-      {
-	*lineptr = '\0';
+      column ++;
+      *lineptr++ = ch;
+    }
 
-	mmd_add(parent, type, whitespace, text, NULL);
+    if (ch == '\n')
+      break;
+  }
 
-	*lineptr   = '~';
-	text	   = NULL;
-	whitespace = 0;
-      }
+  *lineptr = '\0';
 
-      if (!isspace(lineptr[2] & 255) && type == MMD_TYPE_NORMAL_TEXT)
-      {
-	type = MMD_TYPE_STRUCK_TEXT;
-	text = lineptr + 2;
-      }
-      else
-      {
-	lineptr ++;
-	type = MMD_TYPE_NORMAL_TEXT;
-      }
-    }
-    else if (*lineptr == '`' && (type != MMD_TYPE_CODE_TEXT || lineptr[-1] != '\\'))
-    {
-      if (type != MMD_TYPE_NORMAL_TEXT || !delim)
-      {
-	if (lineptr[1] == '`')
-	{
-	  if (lineptr[2] == '`')
-	  {
-	    delim    = "```";
-	    delimlen = 3;
-	  }
-	  else
-	  {
-	    delim    = "``";
-	    delimlen = 2;
-	  }
-	}
-	else
-	{
-	  delim	   = "`";
-	  delimlen = 1;
-	}
-      }
+  if (file->bufptr == file->bufend && lineptr == line)
+    return (NULL);
+  else if (!strchr(file->bufptr, '\n'))
+    mmd_read_buffer(file);
+
+  DEBUG2_printf("mmd_read_line: Returning \"%s\"\n", line);
+
+  file->lines ++;
+
+  return (line);
+}
+
+
+//
+// 'mmd_ref_add()' - Add or update a reference...
+//
 
-      if (type != MMD_TYPE_CODE_TEXT && delim && !strstr(lineptr + delimlen, delim))
-      {
-	if (!text)
-	  text = lineptr;
+static void
+mmd_ref_add(_mmd_doc_t *doc,		// I - Document
+	    mmd_t      *node,		// I - Link node, if any
+	    const char *name,		// I - Reference name
+	    const char *url,		// I - Reference URL
+	    const char *title)		// I - Title, if any
+{
+  size_t	i;			// Looping var
+  _mmd_ref_t	*ref;			// Reference
 
-	delim	 = NULL;
-	delimlen = 0;
-	continue;
-      }
 
-      if (text)
+  DEBUG2_printf("mmd_ref_add(doc=%p, node=%p, name=\"%s\", url=\"%s\", title=\"%s\")\n", doc, node, name, url, title);
+
+  if (doc->error)
+    return;
+
+  if (doc->defer_refs)
+  {
+    // Save the reference for mmdLoadParallel...
+    _mmd_defer_t *deferred;		// Deferred reference
+
+    if (doc->num_deferred >= doc->alloc_deferred)
+    {
+      if ((deferred = mmd_realloc(doc, doc->deferred, (doc->alloc_deferred + 256) * sizeof(_mmd_defer_t))) == NULL)
       {
-	DEBUG2_printf("mmd_parse_inline: text=\"%s\"\n", text);
+        doc->error = ENOMEM;
+        return;
+      }
 
-	if (!strncmp(lineptr, delim, delimlen))
-	{
-	  char	*textptr = lineptr;
+      doc->deferred       = deferred;
+      doc->alloc_deferred += 256;
+    }
 
-	  while (textptr > text && isspace(textptr[-1] & 255))
-	    textptr --;
+    deferred = doc->deferred + doc->num_deferred;
+    doc->num_deferred ++;
 
-	  *textptr = '\0';
-	  lineptr += delimlen - 1;
-	}
+    deferred->node  = node;
+    deferred->name  = mmd_strdup(doc, name);
+    deferred->url   = url ? mmd_strdup(doc, url) : NULL;
+    deferred->title = title ? mmd_strdup(doc, title) : NULL;
+    return;
+  }
 
-	if (type == MMD_TYPE_CODE_TEXT)
-	{
-	  if (whitespace && !*text)
-	  {
-	    mmd_add(parent, type, 0, " ", NULL);
-	    whitespace = 0;
-	  }
-	}
+  if ((ref = mmd_ref_find(doc, name)) != NULL)
+  {
+    DEBUG2_printf("mmd_ref_add: ref=%p, ref->url=\"%s\"\n", ref, ref->url);
 
-	mmd_add(parent, type, whitespace, text, NULL);
+    if (!ref->url && url)
+    {
+      // Links share the reference's strings, which are kept in the document's
+      // memory...
+      ref->url   = doc->strings ? mmd_intern(doc, url) : mmd_ref_strdup(doc, NULL, url);
+      ref->title = title ? mmd_ref_strdup(doc, NULL, title) : NULL;
 
-	text	   = NULL;
-	whitespace = 0;
+      if (node)
+      {
+	node->url   = ref->url;
+	node->extra = ref->title;
       }
 
-      if (type == MMD_TYPE_CODE_TEXT)
+      for (i = 0; i < ref->num_pending; i ++)
       {
-	DEBUG2_puts("mmd_parse_inline: Reverting to normal text.\n");
-
-	type	 = MMD_TYPE_NORMAL_TEXT;
-	delim	 = NULL;
-	delimlen = 0;
+	ref->pending[i]->url   = ref->url;
+	ref->pending[i]->extra = ref->title;
       }
-      else
-      {
-	type	= MMD_TYPE_CODE_TEXT;
-	lineptr += delimlen - 1;
 
-	while (isspace(lineptr[1] & 255))
-	  lineptr ++;
+      doc->stats.references ++;
+      doc->stats.resolved += ref->num_pending;
 
-	text = lineptr + 1;
-      }
+      doc->num_pending -= ref->num_pending;
+      ref->num_pending = 0;
+      return;
     }
-    else if (!strncmp(lineptr, "\\\n", 2))
+  }
+  else if (mmd_limits[MMD_LIMIT_REFERENCES] && doc->num_references >= mmd_limits[MMD_LIMIT_REFERENCES])
+  {
+    DEBUG_printf("mmd_ref_add: Too many references (%lu).\n", (unsigned long)doc->num_references);
+    doc->error = EFBIG;
+    return;
+  }
+  else
+  {
+    if (doc->num_references >= doc->alloc_references)
     {
-      // Hard break
-      *lineptr++ = '\0';
+      // Grow the references array, keeping the pending arrays of old slots...
+      size_t alloc_references = doc->alloc_references ? 2 * doc->alloc_references : 16;
+					// New allocation
 
-      if (text)
+      if ((ref = mmd_realloc(doc, doc->references, alloc_references * sizeof(_mmd_ref_t))) == NULL)
       {
-        mmd_add(parent, type, whitespace, text, NULL);
-
-        text       = NULL;
-        whitespace = false;
+        doc->error = ENOMEM;
+        return;
       }
 
-      mmd_add(parent, MMD_TYPE_HARD_BREAK, false, NULL, NULL);
+      memset(ref + doc->alloc_references, 0, (alloc_references - doc->alloc_references) * sizeof(_mmd_ref_t));
+
+      doc->references       = ref;
+      doc->alloc_references = alloc_references;
     }
-    else if (!text)
+
+    if (2 * (doc->num_references + 1) > doc->alloc_refhash)
     {
-      if (*lineptr == '\\' && ispunct(lineptr[1] & 255) && type != MMD_TYPE_CODE_TEXT)
+      // Grow the hash table and add the existing references...
+      size_t	*refhash,		// New hash table
+		alloc_refhash = doc->alloc_refhash ? 2 * doc->alloc_refhash : 64;
+					// New size
+
+      if ((refhash = mmd_realloc(doc, doc->refhash, alloc_refhash * sizeof(size_t))) == NULL)
       {
-        // Escaped character...
-	lineptr ++;
+        doc->error = ENOMEM;
+        return;
       }
 
-      text = lineptr;
+      doc->refhash       = refhash;
+      doc->alloc_refhash = alloc_refhash;
+
+      memset(refhash, 0, alloc_refhash * sizeof(size_t));
+
+      for (i = 0; i < doc->num_references; i ++)
+      {
+        size_t hash;			// Hash index
+
+        for (hash = mmd_ref_hash(doc, doc->references[i].name); refhash[hash]; hash = (hash + 1) & (alloc_refhash - 1));
+
+        refhash[hash] = i + 1;
+      }
     }
-    else if (*lineptr == '\\' && ispunct(lineptr[1] & 255) && type != MMD_TYPE_CODE_TEXT)
+    else if (doc->num_references == 0)
     {
-      // Escaped character...
-      memmove(lineptr, lineptr + 1, strlen(lineptr));
+      // Clear references from a previous load...
+      memset(doc->refhash, 0, doc->alloc_refhash * sizeof(size_t));
     }
-  }
-
-  if (text)
-  {
-    DEBUG_puts("mms_parse_inline: Adding text at end.\n");
-    mmd_add(parent, type, whitespace, text, NULL);
-  }
-}
 
+    ref = doc->references + doc->num_references;
+    doc->num_references ++;
 
-//
-// 'mmd_parse_link()' - Parse a link.
-//
+    ref->name	     = mmd_ref_strdup(doc, NULL, name);
+    ref->url	     = !url ? NULL : doc->strings ? mmd_intern(doc, url) : mmd_ref_strdup(doc, NULL, url);
+    ref->title	     = title ? mmd_ref_strdup(doc, NULL, title) : NULL;
+    ref->num_pending = 0;
 
-static char *				// O - End of link text
-mmd_parse_link(_mmd_doc_t *doc,		// I - Document
-	       char	  *lineptr,	// I - Pointer into line
-	       char	  **text,	// O - Text
-	       char	  **url,	// O - URL
-	       char	  **title,	// O - Title, if any
-	       char	  **refname)	// O - Reference name
-{
-  lineptr ++; // skip "["
+    for (i = mmd_ref_hash(doc, name); doc->refhash[i]; i = (i + 1) & (doc->alloc_refhash - 1));
 
-  *text	   = lineptr;
-  *url	   = NULL;
-  *refname = NULL;
+    doc->refhash[i] = doc->num_references;
 
-  if (title)
-    *title = NULL;
+    if (url)
+      doc->stats.references ++;
+  }
 
-  while (*lineptr && *lineptr != ']')
+  if (node)
   {
-    if (*lineptr == '\"' || *lineptr == '\'')
+    if (ref->url)
     {
-      char quote = *lineptr++;
+      node->url	  = ref->url;
+      node->extra = ref->title;
+    }
+    else
+    {
+      if (ref->num_pending >= ref->alloc_pending)
+      {
+        mmd_t	**pending;		// New pending array
 
-      while (*lineptr && *lineptr != quote)
-	lineptr ++;
+        if ((pending = mmd_realloc(doc, ref->pending, (ref->alloc_pending + 16) * sizeof(mmd_t *))) == NULL)
+        {
+          doc->error = ENOMEM;
+          return;
+        }
 
-      if (!*lineptr)
-	return (lineptr);
-    }
+        ref->pending       = pending;
+        ref->alloc_pending += 16;
+      }
 
-    lineptr ++;
+      ref->pending[ref->num_pending ++] = node;
+      doc->num_pending ++;
+      doc->stats.pending ++;
+    }
   }
+}
 
-  if (!*lineptr)
-    return (lineptr);
 
-  *lineptr++ = '\0';
+//
+// 'mmd_ref_clear()' - Convert unresolved reference links to plain text.
+//
 
-  if (*lineptr == '(')
-  {
-    // Get URL...
-    lineptr ++;
-    *url = lineptr;
+static void
+mmd_ref_clear(_mmd_doc_t *doc)		// I - Document
+{
+  size_t	i;			// Looping var
+  _mmd_ref_t	*reference;		// Current reference
+  bool		cleared = false;	// Were any links cleared?
 
-    while (*lineptr && *lineptr != ')')
-    {
-      if (isspace(*lineptr & 255))
-      {
-	*lineptr = '\0';
-      }
-      else if (*lineptr == '\\' && lineptr[1])
-      {
-        if (lineptr[1] == ')')
-        {
-	  // Remove "\"
-	  memmove(lineptr, lineptr + 1, strlen(lineptr));
-	}
-	else
-	{
-	  // Keep "\"
-	  lineptr ++;
-	}
-      }
-      else if (*lineptr == '\"' || *lineptr == '\'')
-      {
-	char quote = *lineptr++;
 
-	if (title)
-	  *title = lineptr;
+  for (i = doc->num_references, reference = doc->references; i > 0 && doc->num_pending > 0; i --, reference ++)
+  {
+    if (reference->num_pending > 0)
+    {
+      char	text[8192];		// Reference text
+      size_t	j;			// Looping var
 
-	while (*lineptr && *lineptr != quote)
-	{
-	  if (*lineptr == '\\' && lineptr[1])
-	  {
-	    // Remove "\"
-	    memmove(lineptr, lineptr + 1, strlen(lineptr));
-	  }
+      DEBUG2_printf("Clearing links for '%s'.\n", reference->name);
+      snprintf(text, sizeof(text), "[%s]", reference->name);
 
-	  lineptr ++;
-	}
+      for (j = 0; j < reference->num_pending; j ++)
+      {
+	doc->stats.nodes[reference->pending[j]->type] --;
+	doc->stats.nodes[MMD_TYPE_NORMAL_TEXT] ++;
 
-	if (!*lineptr)
-	  return (lineptr);
-	else if (title)
-	  *lineptr = '\0';
+	reference->pending[j]->text    = mmd_ref_strdup(doc, reference->pending[j], text);
+	reference->pending[j]->textlen = strlen(text);
+	reference->pending[j]->type = MMD_TYPE_NORMAL_TEXT;
       }
 
-      lineptr ++;
+      doc->num_pending       -= reference->num_pending;
+      reference->num_pending = 0;
+      cleared                = true;
     }
-
-    *lineptr++ = '\0';
   }
-  else if (*lineptr == '[')
-  {
-    // Get reference...
-    lineptr ++;
-    *refname = lineptr;
 
-    while (*lineptr && *lineptr != ']')
-    {
-      if (isspace(*lineptr & 255))
-      {
-	*lineptr = '\0';
-      }
-      else if (*lineptr == '\\' && lineptr[1])
-      {
-        if (lineptr[1] == ']')
-        {
-	  // Remove "\"
-	  memmove(lineptr, lineptr + 1, strlen(lineptr));
-	}
-	else
-	{
-	  // Keep "\"
-	  lineptr ++;
-	}
-      }
-      else if (*lineptr == '\"' || *lineptr == '\'')
-      {
-	char quote = *lineptr++;
+  // Remove the links and images that are now plain text from the index...
+  if (cleared && doc->num_indexed)
+    mmd_nodes_check(doc);
+}
 
-	if (title)
-	  *title = lineptr;
 
-	while (*lineptr && *lineptr != quote)
-	  lineptr ++;
+//
+// 'mmd_ref_find()' - Find a reference...
+//
 
-	if (!*lineptr)
-	  return (lineptr);
-	else
-	  *lineptr = '\0';
-      }
+static _mmd_ref_t *			// O - Reference or NULL
+mmd_ref_find(_mmd_doc_t *doc,		// I - Document
+	     const char *name)		// I - Reference name
+{
+  size_t	hash,			// Hash index
+		index;			// Reference index + 1
 
-      lineptr ++;
-    }
 
-    *lineptr++ = '\0';
-    if (!**refname)
-      *refname = *text;
-  }
-  else if (*lineptr == ':')
+  if (doc->num_references == 0)
+    return (NULL);
+
+  for (hash = mmd_ref_hash(doc, name); (index = doc->refhash[hash]) != 0; hash = (hash + 1) & (doc->alloc_refhash - 1))
   {
-    // Get reference definition...
-    lineptr ++;
-    while (*lineptr && isspace(*lineptr & 255))
-      lineptr ++;
+    if (!strcasecmp(name, doc->references[index - 1].name))
+      return (doc->references + index - 1);
+  }
+
+  return (NULL);
+}
+
+
+//
+// 'mmd_ref_hash()' - Compute the hash index for a reference name.
+//
+// Reference names are compared without regard to case, so the hash uses the
+// lowercase characters.
+//
 
-    *url = lineptr;
+static size_t				// O - Hash index
+mmd_ref_hash(_mmd_doc_t *doc,		// I - Document
+             const char *name)		// I - Reference name
+{
+  size_t	hash = 2166136261U;	// Hash value
 
-    while (*lineptr && !isspace(*lineptr & 255))
-    {
-      if (*lineptr == '\\' && lineptr[1])
-      {
-        // Remove "\"
-	memmove(lineptr, lineptr + 1, strlen(lineptr));
-      }
 
-      lineptr ++;
-    }
+  for (; *name; name ++)
+    hash = (hash ^ (size_t)tolower(*name & 255)) * 16777619U;
 
-    if (*lineptr)
-    {
-      *lineptr++ = '\0';
-      while (*lineptr && isspace(*lineptr & 255))
-	lineptr ++;
+  return (hash & (doc->alloc_refhash - 1));
+}
 
-      if (*lineptr == '\"' || *lineptr == '\'')
-      {
-	char quote = *lineptr++;
 
-	if (title)
-	  *title = lineptr;
+//
+// 'mmd_ref_strdup()' - Copy a string for a reference or a link using it.
+//
+// When a block callback is set, strings for a link in the current top-level
+// block are copied to the memory of the block and all other strings to the
+// document's memory, since references and held blocks outlive the current
+// block.  Links share the URL and title strings of their reference.
+//
 
-	while (*lineptr && *lineptr != quote)
-	{
-	  if (*lineptr == '\\' && lineptr[1])
-	  {
-	    // Remove "\"
-	    memmove(lineptr, lineptr + 1, strlen(lineptr));
-	  }
+static char *				// O - Copy of string
+mmd_ref_strdup(_mmd_doc_t *doc,		// I - Document
+               mmd_t      *node,	// I - Link node or `NULL` for the reference
+               const char *s)		// I - String
+{
+  char		*ret,			// Copy of string
+		*inline_start,		// Saved start of inline text
+		*inline_end;		// Saved end of inline text
+  size_t	cur_held;		// Saved allocation block
 
-	  lineptr ++;
-	}
 
-	if (!*lineptr)
-	  return (lineptr);
-	else
-	  *lineptr = '\0';
-      }
-    }
+  if (!doc->block_cb)
+    return (mmd_strdup(doc, s));
 
-    mmd_ref_add(doc, NULL, *text, *url, title ? *title : NULL);
+  inline_start = doc->inline_start;
+  inline_end   = doc->inline_end;
+  cur_held     = doc->cur_held;
 
-    *text = NULL;
-    *url  = NULL;
+  doc->inline_start = doc->inline_end = NULL;
 
-    if (title)
-      *title = NULL;
-  }
-  else
-  {
-    // Shortcut reference...
-    *refname = *text;
-  }
+  if (!node || !cur_held || doc->held[cur_held - 1].block != mmd_block_top(doc, node))
+    doc->cur_held = 0;
 
-  return (lineptr);
+  ret = mmd_strdup(doc, s);
+
+  doc->inline_start = inline_start;
+  doc->inline_end   = inline_end;
+  doc->cur_held     = cur_held;
+
+  return (ret);
 }
 
 
 //
-// 'mmd_read_buffer()' - Fill the file buffer with more data from a file.
+// 'mmd_release()' - Free memory using a document's allocator.
 //
 
 static void
-mmd_read_buffer(_mmd_filebuf_t *file)	// I - File buffer
+mmd_release(_mmd_doc_t *doc,		// I - Document or `NULL` for the standard C library
+            void       *ptr)		// I - Memory to free
 {
-  size_t	bytes;			// Bytes read
+  if (ptr)
+    mmd_realloc(doc, ptr, 0);
+}
 
 
-  if (file->bufptr && file->bufptr > file->buffer)
-  {
-    // Discard previous characters in the buffer.
-    DEBUG2_printf("mmd_read_buffer: before buffer=\"%s\"\n", file->bufptr);
+//
+// 'mmd_remove()' - Remove a node from its parent.
+//
 
-    memmove(file->buffer, file->bufptr, file->bufend - file->bufptr);
-    file->bufend -= (file->bufptr - file->buffer);
-  }
-  else
+static void
+mmd_remove(mmd_t *node)			// I - Node
+{
+  if (node && node->parent)
   {
-    // Otherwise just clear the buffer...
-    file->bufend = file->buffer;
+    if (node->prev_sibling)
+      node->prev_sibling->next_sibling = node->next_sibling;
+    else
+      node->parent->first_child = node->next_sibling;
+
+    if (node->next_sibling)
+      node->next_sibling->prev_sibling = node->prev_sibling;
+    else
+      node->parent->last_child = node->prev_sibling;
+
+    node->parent       = NULL;
+    node->prev_sibling = NULL;
+    node->next_sibling = NULL;
   }
+}
 
-  if ((bytes = (file->cb)(file->cbdata, file->bufend, sizeof(file->buffer) - (size_t)(file->bufend - file->buffer) - 1)) > 0)
-    file->bufend += bytes;
 
-  *(file->bufend) = '\0';
-  file->bufptr    = file->buffer;
+//
+// 'mmd_strdup()' - Copy a string into the document's memory.
+//
 
-  DEBUG2_printf("mmd_read_buffer: after buffer=\"%s\"\n", file->buffer);
+static char *				// O - Copy of string
+mmd_strdup(_mmd_doc_t *doc,		// I - Document
+           const char *s)		// I - String
+{
+  return (mmd_strndup(doc, s, strlen(s)));
 }
 
 
 //
-// 'mmd_read_line()' - Read a line from a file in a Markdown-aware way.
+// 'mmd_strings_add()' - Add a string to a string table.
+//
+// The table uses open addressing with FNV-1a hashes and is kept at most half
+// full.
 //
 
-static char *				// O - Pointer to line or `NULL` on EOF
-mmd_read_line(_mmd_filebuf_t *file,	// I - File buffer
-	      char	     *line,	// I - Line buffer
-	      size_t	     linesize)	// I - Size of line buffer
+static char *				// O - String in table or `NULL` on error
+mmd_strings_add(mmd_strings_t *strings,	// I - String table
+                const char    *s)	// I - String
 {
-  int	ch,				// Current character
-	column = 0;			// Current column
-  char	*lineptr = line,		// Pointer into line
-	*lineend = line + linesize - 1; // Pointer to end of buffer
+  size_t	hash = mmd_strings_hash(s),
+					// Hash of string
+		len = strlen(s) + 1,	// Length of string
+		i = 0;			// Looping var
+  char		*ret = NULL;		// String in table
+  _mmd_chunk_t	*chunk;			// Current chunk
 
 
-  // Fill the buffer as needed...
-  if (!file->bufptr || (file->bufptr >= file->bufend) || !strchr(file->bufptr, '\n'))
-    mmd_read_buffer(file);
+#if _WIN32
+  EnterCriticalSection(&strings->mutex);
+#else
+  pthread_mutex_lock(&strings->mutex);
+#endif // _WIN32
 
-  // Copy a line out of the file buffer...
-  while (file->bufptr < file->bufend)
+  // Look for an existing copy of the string...
+  if (strings->alloc_strings)
   {
-    ch = *(file->bufptr);
-    file->bufptr ++;
+    for (i = hash & (strings->alloc_strings - 1); strings->strings[i]; i = (i + 1) & (strings->alloc_strings - 1))
+    {
+      if (!strcmp(strings->strings[i], s))
+      {
+        ret = strings->strings[i];
+        break;
+      }
+    }
+  }
 
-    if (ch == '\t')
+  if (!ret && 2 * (strings->num_strings + 1) > strings->alloc_strings)
+  {
+    // Grow the hash table and add the existing strings to it...
+    size_t	alloc_strings = strings->alloc_strings ? 2 * strings->alloc_strings : 1024,
+					// New size of table
+		j;			// Looping var
+    char	**table;		// New table
+
+    if ((table = mmd_strings_realloc(strings, NULL, alloc_strings * sizeof(char *))) != NULL)
     {
-      // Expand tabs since nobody uses the same tab width and Markdown says
-      // 4 columns per tab...
-      do
+      memset(table, 0, alloc_strings * sizeof(char *));
+
+      for (j = 0; j < strings->alloc_strings; j ++)
       {
-	column ++;
-	if (lineptr < lineend)
-	  *lineptr++ = ' ';
+	if (!strings->strings[j])
+	  continue;
+
+	for (i = mmd_strings_hash(strings->strings[j]) & (alloc_strings - 1); table[i]; i = (i + 1) & (alloc_strings - 1));
+
+	table[i] = strings->strings[j];
       }
-      while (column  & 3);
+
+      mmd_strings_realloc(strings, strings->strings, 0);
+
+      strings->strings       = table;
+      strings->alloc_strings = alloc_strings;
+
+      for (i = hash & (alloc_strings - 1); table[i]; i = (i + 1) & (alloc_strings - 1));
     }
-    else if (ch != '\r' && lineptr < lineend)
+  }
+
+  if (!ret && 2 * (strings->num_strings + 1) <= strings->alloc_strings)
+  {
+    // Copy the string to the current chunk or a new one...
+    if ((chunk = strings->chunks) == NULL || (chunk->size - chunk->used) < len)
     {
-      column ++;
-      *lineptr++ = ch;
+      size_t size = len > MMD_CHUNK_MIN ? len : MMD_CHUNK_MIN;
+					// Size of new chunk
+
+      if ((chunk = mmd_strings_realloc(strings, NULL, sizeof(_mmd_chunk_t) + size)) != NULL)
+      {
+	chunk->next     = strings->chunks;
+	chunk->size     = size;
+	chunk->used     = 0;
+	strings->chunks = chunk;
+      }
     }
 
-    if (ch == '\n')
-      break;
-  }
+    if (chunk)
+    {
+      ret = (char *)(chunk + 1) + chunk->used;
+      chunk->used += len;
 
-  *lineptr = '\0';
+      memcpy(ret, s, len);
 
-  if (file->bufptr == file->bufend && lineptr == line)
-    return (NULL);
-  else if (!strchr(file->bufptr, '\n'))
-    mmd_read_buffer(file);
+      strings->strings[i] = ret;
+      strings->num_strings ++;
+    }
+  }
 
-  DEBUG2_printf("mmd_read_line: Returning \"%s\"\n", line);
+#if _WIN32
+  LeaveCriticalSection(&strings->mutex);
+#else
+  pthread_mutex_unlock(&strings->mutex);
+#endif // _WIN32
 
-  return (line);
+  return (ret);
 }
 
 
 //
-// 'mmd_ref_add()' - Add or update a reference...
+// 'mmd_strings_hash()' - Compute the FNV-1a hash of a string.
 //
 
-static void
-mmd_ref_add(_mmd_doc_t *doc,		// I - Document
-	    mmd_t      *node,		// I - Link node, if any
-	    const char *name,		// I - Reference name
-	    const char *url,		// I - Reference URL
-	    const char *title)		// I - Title, if any
+static size_t				// O - Hash
+mmd_strings_hash(const char *s)		// I - String
 {
-  size_t	i;			// Looping var
-  _mmd_ref_t	*ref = mmd_ref_find(doc, name);
-					// Reference
+  size_t	hash = 2166136261U;	// Hash of string
 
 
-  DEBUG2_printf("mmd_ref_add(doc=%p, node=%p, name=\"%s\", url=\"%s\", title=\"%s\")\n", doc, node, name, url, title);
+  while (*s)
+    hash = (hash ^ (unsigned char)*s++) * 16777619U;
 
-  if (ref)
-  {
-    DEBUG2_printf("mmd_ref_add: ref=%p, ref->url=\"%s\"\n", ref, ref->url);
+  return (hash);
+}
 
-    if (!ref->url && url)
-    {
-      if (node)
-	node->url = strdup(url);
 
-      ref->url = strdup(url);
+//
+// 'mmd_strings_realloc()' - Allocate or free memory using a string table's
+//                           allocator.
+//
 
-      if (title)
-      {
-	if (node)
-	  node->extra = strdup(title);
+static void *				// O - Memory or `NULL`
+mmd_strings_realloc(
+    mmd_strings_t *strings,		// I - String table
+    void          *ptr,			// I - Memory to reallocate or `NULL` to allocate
+    size_t        bytes)		// I - Number of bytes or `0` to free
+{
+  if (strings->alloc_cb)
+    return ((strings->alloc_cb)(strings->alloc_data, ptr, bytes));
 
-	ref->title = strdup(title);
-      }
+  if (bytes == 0)
+  {
+    free(ptr);
+    return (NULL);
+  }
 
-      for (i = 0; i < ref->num_pending; i ++)
-      {
-	ref->pending[i]->url = strdup(url);
+  return (realloc(ptr, bytes));
+}
 
-	if (title)
-	  ref->pending[i]->extra = strdup(title);
-      }
 
-      free(ref->pending);
+//
+// 'mmd_strndup()' - Copy a string of known length into the document's memory.
+//
+// Strings in the inline text being parsed are already in the document's memory
+// and are not modified after the parser terminates them, so they are used
+// as-is.
+//
 
-      ref->num_pending = 0;
-      ref->pending     = NULL;
-      return;
-    }
-  }
-  else if ((ref = realloc(doc->references, (doc->num_references + 1) * sizeof(_mmd_ref_t))) != NULL)
-  {
-    doc->references = ref;
-    ref += doc->num_references;
-    doc->num_references ++;
+static char *				// O - Copy of string
+mmd_strndup(_mmd_doc_t *doc,		// I - Document
+            const char *s,		// I - String
+            size_t     len)		// I - Length of string
+{
+  char		*copy;			// Copy of string
 
-    ref->name	     = strdup(name);
-    ref->url	     = url ? strdup(url) : NULL;
-    ref->title	     = title ? strdup(title) : NULL;
-    ref->num_pending = 0;
-    ref->pending     = NULL;
-  }
-  else
-    return;
 
-  if (node)
-  {
-    if (ref->url)
-    {
-      node->url	  = strdup(ref->url);
-      node->extra = ref->title ? strdup(ref->title) : NULL;
-    }
-    else if ((ref->pending = realloc(ref->pending, (ref->num_pending + 1) * sizeof(mmd_t *))) != NULL)
-    {
-      ref->pending[ref->num_pending ++] = node;
-    }
-  }
+  if (s >= doc->inline_start && s < doc->inline_end)
+    return ((char *)s);
+
+  if ((copy = mmd_alloc(doc, len + 1)) != NULL)
+    memcpy(copy, s, len + 1);
+
+  return (copy);
 }
 
 
 //
-// 'mmd_ref_find()' - Find a reference...
+// 'mmd_time()' - Get the current time in seconds for statistics.
 //
 
-static _mmd_ref_t *			// O - Reference or NULL
-mmd_ref_find(_mmd_doc_t *doc,		// I - Document
-	     const char *name)		// I - Reference name
+static double				// O - Time in seconds
+mmd_time(void)
 {
-  size_t	i;			// Looping var
+#if _WIN32
+  LARGE_INTEGER	count,			// Performance counter
+		freq;			// Performance counter frequency
 
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&freq);
 
-  for (i = 0; i < doc->num_references; i ++)
-    if (!strcasecmp(name, doc->references[i].name))
-      return (doc->references + i);
+  return ((double)count.QuadPart / (double)freq.QuadPart);
 
-  return (NULL);
+#else
+  struct timespec ts;			// Current time
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ((double)ts.tv_sec + 0.000000001 * (double)ts.tv_nsec);
+#endif // _WIN32
 }
 
 
 //
-// 'mmd_remove()' - Remove a node from its parent.
+// 'mmd_unescape()' - Remove the "\" from escaped characters in a string.
+//
+// This is done in a single pass once the extent of a text fragment is known,
+// rather than shifting the rest of the line for each escape.
 //
 
-static void
-mmd_remove(mmd_t *node)			// I - Node
+static char *				// O - End of string
+mmd_unescape(char *s)			// I - String
 {
-  if (node && node->parent)
+  char	*ptr;				// Output pointer
+
+
+  for (ptr = s; *s; s ++)
   {
-    if (node->prev_sibling)
-      node->prev_sibling->next_sibling = node->next_sibling;
-    else
-      node->parent->first_child = node->next_sibling;
+    if (*s == '\\' && ispunct(s[1] & 255))
+      s ++;
 
-    if (node->next_sibling)
-      node->next_sibling->prev_sibling = node->prev_sibling;
-    else
-      node->parent->last_child = node->prev_sibling;
+    *ptr++ = *s;
+  }
 
-    node->parent       = NULL;
-    node->prev_sibling = NULL;
-    node->next_sibling = NULL;
+  *ptr = '\0';
+
+  return (ptr);
+}
+
+
+//
+// 'mmd_walk()' - Return the next node in a depth-first walk of a tree.
+//
+
+static mmd_t *				// O - Next node or `NULL` at the end
+mmd_walk(mmd_t  *top,			// I - Top node of the walk
+         mmd_t  *current,		// I - Current node
+         size_t *depth)			// IO - Depth of node below the top node
+{
+  mmd_t	*next;				// Next node
+
+
+  if ((next = current->first_child) != NULL)
+  {
+    (*depth) ++;
+    return (next);
   }
+
+  for (next = current; next != top && !next->next_sibling; next = next->parent)
+    (*depth) --;
+
+  return (next == top ? NULL : next->next_sibling);
 }
 
 
@@ -22,13 +22,25 @@ extern "C" {
 // Constants...
 //
 
+typedef enum mmd_limit_e
+{
+  MMD_LIMIT_BYTES,			// Maximum number of input bytes
+  MMD_LIMIT_NODES,			// Maximum number of nodes
+  MMD_LIMIT_DEPTH,			// Maximum block nesting depth
+  MMD_LIMIT_REFERENCES,			// Maximum number of link references
+  MMD_LIMIT_INLINE			// Maximum number of inline nodes per block
+} mmd_limit_t;
+
 enum mmd_option_e
 {
   MMD_OPTION_NONE = 0x00,		// No markdown extensions
   MMD_OPTION_METADATA = 0x01,		// Jekyll metadata extension
   MMD_OPTION_TABLES = 0x02,		// Github table extension
   MMD_OPTION_TASKS = 0x04,		// Github task item extension (check boxes)
-  MMD_OPTION_ALL = 0x07			// All supported markdown extensions
+  MMD_OPTION_ALL = 0x07,		// All supported markdown extensions
+  MMD_OPTION_LAZY_INLINE = 0x08,	// Parse inline text when first accessed
+  MMD_OPTION_CODE_BLOCK_TEXT = 0x10,	// Store each code block as a single text node
+  MMD_OPTION_NODE_INDEX = 0x20		// Index nodes by type for mmdGetNodesOfType
 };
 typedef unsigned mmd_option_t;
 
@@ -77,8 +89,39 @@ typedef enum mmd_type_e
 //
 
 typedef struct _mmd_s mmd_t;		// Markdown node
+typedef void *(*mmd_alloc_cb_t)(void *cbdata, void *ptr, size_t bytes);
+					// mmdNew allocator function
+typedef void (*mmd_block_cb_t)(void *cbdata, mmd_t *block);
+					// mmdSetBlockCallback callback function
+typedef struct mmd_heading_s		// Heading in a document outline
+{
+  mmd_t		*node;			// Heading node
+  int		level;			// Heading level (1-6)
+  const char	*text;			// Heading text
+} mmd_heading_t;
 typedef size_t (*mmd_iocb_t)(void *cbdata, char *buffer, size_t bytes);
 					// mmdLoadIO callback function
+typedef struct _mmd_parser_s mmd_parser_t;
+					// Incremental markdown parser
+typedef struct mmd_stats_s		// Parse statistics
+{
+  size_t	bytes,			// Number of bytes read
+		lines,			// Number of lines read
+		refills,		// Number of read buffer refills
+		continuations,		// Number of continuation lines joined
+		nodes[MMD_TYPE_CHECKBOX + 1],
+					// Number of nodes created by type
+		references,		// Number of link references defined
+		pending,		// Number of links that waited for a reference
+		resolved,		// Number of waiting links that were resolved
+		allocs,			// Number of node and string allocations
+		alloc_bytes,		// Number of bytes allocated for nodes and strings
+		chunks;			// Number of memory chunks allocated
+  double	block_time,		// Seconds spent parsing blocks
+		inline_time;		// Seconds spent parsing inline text
+} mmd_stats_t;
+typedef struct _mmd_strings_s mmd_strings_t;
+					// String table
 
 //
 // Functions...
@@ -86,24 +129,45 @@ typedef size_t (*mmd_iocb_t)(void *cbdata, char *buffer, size_t bytes);
 
 extern char         *mmdCopyAllText(mmd_t *node);
 extern void         mmdFree(mmd_t *node);
+extern bool         mmdFreeze(mmd_t *doc);
 extern const char   *mmdGetExtra(mmd_t *node);
 extern mmd_t        *mmdGetFirstChild(mmd_t *node);
 extern mmd_t        *mmdGetLastChild(mmd_t *node);
+extern size_t       mmdGetLimit(mmd_limit_t limit);
 extern const char   *mmdGetMetadata(mmd_t *doc, const char *keyword);
 extern mmd_t        *mmdGetNextSibling(mmd_t *node);
+extern mmd_t        **mmdGetNodesOfType(mmd_t *doc, mmd_type_t type, size_t *num_nodes);
 extern mmd_option_t mmdGetOptions(void);
+extern const mmd_heading_t *mmdGetOutline(mmd_t *doc, size_t *num_headings);
 extern mmd_t        *mmdGetParent(mmd_t *node);
 extern mmd_t        *mmdGetPrevSibling(mmd_t *node);
+extern const mmd_stats_t *mmdGetStats(mmd_t *doc);
 extern const char   *mmdGetText(mmd_t *node);
+extern size_t       mmdGetTextLength(mmd_t *node);
 extern mmd_type_t   mmdGetType(mmd_t *node);
 extern const char   *mmdGetURL(mmd_t *node);
 extern bool         mmdGetWhitespace(mmd_t *node);
 extern bool         mmdIsBlock(mmd_t *node);
 extern mmd_t        *mmdLoad(mmd_t *root, const char *filename);
+extern mmd_t        *mmdLoadBinary(mmd_t *root, const void *buffer, size_t bytes);
 extern mmd_t        *mmdLoadFile(mmd_t *root, FILE *fp);
 extern mmd_t        *mmdLoadIO(mmd_t *root, mmd_iocb_t cb, void *cbdata);
+extern mmd_t        *mmdLoadMetadata(mmd_t *root, const char *filename);
+extern mmd_t        *mmdLoadParallel(mmd_t *root, const char *buffer, size_t bytes, int num_threads);
 extern mmd_t        *mmdLoadString(mmd_t *root, const char *s);
+extern mmd_t        *mmdNew(mmd_alloc_cb_t cb, void *cbdata);
+extern void         mmdParseInlines(mmd_t *node);
+extern bool         mmdParserFeed(mmd_parser_t *parser, const char *data, size_t bytes);
+extern mmd_t        *mmdParserFinish(mmd_parser_t *parser);
+extern mmd_parser_t *mmdParserNew(mmd_t *root);
+extern void         mmdReset(mmd_t *doc);
+extern bool         mmdSave(mmd_t *node, const char *filename);
+extern void         mmdSetBlockCallback(mmd_t *doc, mmd_block_cb_t cb, void *cbdata);
+extern void         mmdSetLimit(mmd_limit_t limit, size_t value);
 extern void         mmdSetOptions(mmd_option_t options);
+extern void         mmdSetStrings(mmd_t *doc, mmd_strings_t *strings);
+extern void         mmdStringsFree(mmd_strings_t *strings);
+extern mmd_strings_t *mmdStringsNew(mmd_alloc_cb_t cb, void *cbdata);
 
 
 #  ifdef __cplusplus
@@ -10,6 +10,7 @@
 //
 // Options:
 //
+//    --cache-dir dirname	Cache rendered output in the specified directory.
 //    --cover filename.ext	Specify cover image.
 //    --css filename.css	Specify style sheet.
 //    --front filename.md	Specify frontmatter file.
@@ -33,12 +34,24 @@
 #include <ctype.h>
 #include <errno.h>
 #include <time.h>
+#include <sys/stat.h>
+#include <stdint.h>
 
 #if _WIN32
+#  include <direct.h>
 #  define localtime_r(t,tm) localtime_s(tm,t)
+#  define mkdir(d,m) _mkdir(d)
 #endif // _WIN32
 
 
+//
+// Constants...
+//
+
+#define CACHE_MAGIC	"MMDUTIL-CACHE-3 " VERSION
+					// First line of cache files
+
+
 //
 // Local types...
 //
@@ -49,34 +62,84 @@ typedef enum
   FORMAT_MAN				// Output man page
 } format_t;
 
+typedef struct anchor_s
+{
+  const char	*anchor;		// Anchor string
+  unsigned	suffix;			// Next suffix for duplicates of anchor
+} anchor_t;
+
+typedef struct anchors_s
+{
+  size_t	num_anchors;		// Number of anchors
+  size_t	hash_size;		// Size of hash table (power of 2)
+  anchor_t	*by_name;		// Anchors hashed by anchor string
+} anchors_t;
+
 typedef struct toc_s
 {
   int	level;				// Heading level
+  bool	top;				// Top-level heading?
   char	*heading;			// Heading text
+  char	*anchor;			// Anchor string
 } toc_t;
 
+typedef struct file_s
+{
+  const char	*filename;		// Markdown filename or "-" for stdin
+  bool		front;			// Frontmatter file?
+  mmd_t		*doc;			// Markdown document or `NULL` if cached
+  const char	*title,			// Title metadata
+		*author,		// Author metadata
+		*copyright,		// Copyright metadata
+		*version;		// Version metadata
+  char		cachefile[1024];	// Cache filename
+  long		cachepos;		// Offset of rendered output in cache file
+  int		num_headings,		// Number of headings
+		cur_heading;		// Next heading to write
+  toc_t		*headings;		// Headings in document order
+} file_t;
+
 
 //
 // Local functions...
 //
 
-static int		build_toc(mmd_t *parent, int toc_levels, int num_toc, toc_t **toc);
-
-static const char	*html_anchor(const char *text);
-static void		html_block(FILE *outfp, mmd_t *parent);
+static int		add_toc(int num_toc, toc_t **toc, int level, char *heading, char *anchor);
+static void		anchor_add(anchors_t *anchors, const char *name);
+static void		anchor_build(anchors_t *anchors, file_t *file);
+static anchor_t		*anchor_find(anchors_t *anchors, const char *name);
+static size_t		anchor_hash(anchors_t *anchors, const char *name);
+static int		build_toc(file_t *file, int toc_levels, int num_toc, toc_t **toc);
+
+static char		*cache_gets(FILE *fp, bool *error);
+static uint64_t		cache_hash(const char *buffer, size_t bytes, format_t format);
+static void		cache_puts(FILE *fp, const char *s);
+static bool		cache_read(file_t *file);
+static bool		cache_write(file_t *file, format_t format);
+
+static char		*html_anchor(const char *text, char *buffer, size_t bufsize);
+static void		html_block(FILE *outfp, file_t *file, mmd_t *parent);
 static void		html_head(FILE *outfp, const char *cssfile, const char *title, const char *copyright, const char *author, const char *version);
 static void		html_leaf(FILE *outfp, mmd_t *node);
 static void		html_puts(FILE *outfp, const char *s);
 static void		html_titlepage(FILE *outfp, const char *coverfile, const char *title, const char *copyright, const char *author, const char *version);
 static void		html_toc(FILE *outfp, int num_toc, toc_t *toc);
 
+static bool		load_file(file_t *file, const char *cachedir, format_t format, mmd_strings_t *strings);
+static void		load_headings(file_t *file);
+
 static void		man_block(FILE *outfp, mmd_t *parent);
+static void		man_code(FILE *outfp, const char *s);
 static void		man_head(FILE *outfp, int section, const char *title, const char *copyright, const char *author, const char *version);
 static void		man_leaf(FILE *outfp, mmd_t *node);
 static void		man_puts(FILE *outfp, const char *s, int allcaps);
 
+static char		*read_file(const char *filename, size_t *bytes);
+
 static void		usage(void);
 
+static void		write_file(FILE *outfp, file_t *file, format_t format);
+
 
 //
 // 'main()' - Main entry for mini markdown utility.
@@ -88,7 +151,8 @@ main(int  argc,				// I - Number of command-line arguments
 {
   int		i;			// Looping var
   const char	*opt,			// Current option
-		*outfile = NULL;	// Output filename
+		*outfile = NULL,	// Output filename
+		*cachedir = NULL;	// Cache directory
   FILE		*outfp;			// Output file
   format_t	format = FORMAT_HTML;	// Output format
   int		section = 0;		// Section number for man page output
@@ -99,13 +163,28 @@ main(int  argc,				// I - Number of command-line arguments
 		*copyright = NULL,	// Copyright
 		*author = NULL,		// Author
 		*version = NULL;	// Document version
-  mmd_t		*front = NULL,		// Cover page/frontmatter
-		*files[100];		// "Body" files
-  int		num_files = 0,		// Number of files
+  file_t	files[100],		// Input files
+		*file,			// Current input file
+		*front = NULL;		// Cover page/frontmatter
+  int		num_files = 0,		// Number of input files
+		num_body = 0,		// Number of "body" files
 		toc_levels = 0,		// Number of table of contents levels
 		num_toc = 0;		// Number of table of contents entries
   toc_t		*toc = NULL;		// Table of contents entries
+  anchors_t	anchors;		// Heading anchors of all files
+  mmd_strings_t	*strings;		// String table
+
+
+  // Code blocks are written as a whole, so store them as single text nodes...
+  mmdSetOptions(mmdGetOptions() | MMD_OPTION_CODE_BLOCK_TEXT);
 
+  // Share the URLs, languages, and metadata of all files, which also lets links
+  // be compared by pointer...
+  if ((strings = mmdStringsNew(NULL, NULL)) == NULL)
+  {
+    fprintf(stderr, "mmdutil: Unable to create string table: %s\n", strerror(errno));
+    return (1);
+  }
 
   //
   // Process command-line arguments...
@@ -115,7 +194,19 @@ main(int  argc,				// I - Number of command-line arguments
   {
     if (!strncmp(argv[i], "--", 2))
     {
-      if (!strcmp(argv[i], "--cover"))
+      if (!strcmp(argv[i], "--cache-dir"))
+      {
+	i ++;
+	if (i >= argc)
+	{
+	  fputs("mmdutil: Missing cache directory after '--cache-dir'.", stderr);
+	  usage();
+	  return (1);
+	}
+
+	cachedir = argv[i];
+      }
+      else if (!strcmp(argv[i], "--cover"))
       {
 	i ++;
 	if (i >= argc)
@@ -149,20 +240,16 @@ main(int  argc,				// I - Number of command-line arguments
 	  return (1);
 	}
 
-	if ((front = mmdLoad(NULL, argv[i])) == NULL)
+	if (num_files >= (int)(sizeof(files) / sizeof(files[0])))
 	{
-	  fprintf(stderr, "mmdutil: Unable to load \"%s\": %s\n", argv[i], strerror(errno));
+	  fputs("mmdutil: Too many input files.\n", stderr);
 	  return (1);
 	}
 
-	if (!title)
-	  title = mmdGetMetadata(front, "title");
-	if (!author)
-	  author = mmdGetMetadata(front, "author");
-	if (!copyright)
-	  copyright = mmdGetMetadata(front, "copyright");
-	if (!version)
-	  version = mmdGetMetadata(front, "version");
+	memset(files + num_files, 0, sizeof(file_t));
+	files[num_files].filename = argv[i];
+	files[num_files].front    = true;
+	num_files ++;
       }
       else if (!strcmp(argv[i], "--help"))
       {
@@ -235,26 +322,8 @@ main(int  argc,				// I - Number of command-line arguments
     }
     else if (num_files < (int)(sizeof(files) / sizeof(files[0])))
     {
-      if (!strcmp(argv[i], "-"))
-        files[num_files] = mmdLoadFile(NULL, stdin);
-      else
-        files[num_files] = mmdLoad(NULL, argv[i]);
-
-      if (files[num_files] == NULL)
-      {
-	fprintf(stderr, "mmdutil: Unable to load \"%s\": %s\n", argv[i], strerror(errno));
-	return (1);
-      }
-
-      if (!title)
-	title = mmdGetMetadata(files[num_files], "title");
-      if (!author)
-	author = mmdGetMetadata(files[num_files], "author");
-      if (!copyright)
-	copyright = mmdGetMetadata(files[num_files], "copyright");
-      if (!version)
-	version = mmdGetMetadata(files[num_files], "version");
-
+      memset(files + num_files, 0, sizeof(file_t));
+      files[num_files].filename = argv[i];
       num_files ++;
     }
     else
@@ -264,7 +333,37 @@ main(int  argc,				// I - Number of command-line arguments
     }
   }
 
-  if (num_files == 0)
+  //
+  // Load the input files, using the cache as needed...
+//
+
+  if (cachedir && mkdir(cachedir, 0777) && errno != EEXIST)
+  {
+    fprintf(stderr, "mmdutil: Unable to create cache directory \"%s\": %s\n", cachedir, strerror(errno));
+    return (1);
+  }
+
+  for (i = num_files, file = files; i > 0; i --, file ++)
+  {
+    if (!load_file(file, cachedir, format, strings))
+      return (1);
+
+    if (!title)
+      title = file->title;
+    if (!author)
+      author = file->author;
+    if (!copyright)
+      copyright = file->copyright;
+    if (!version)
+      version = file->version;
+
+    if (file->front)
+      front = file;
+    else
+      num_body ++;
+  }
+
+  if (num_body == 0)
   {
     usage();
     return (1);
@@ -281,14 +380,35 @@ main(int  argc,				// I - Number of command-line arguments
   else
     outfp = stdout;
 
+  // Rendering makes many small writes, so use a larger output buffer...
+  setvbuf(outfp, NULL, _IOFBF, 65536);
+
+  //
+  // Make the heading anchors unique across all files, in output order...
+//
+
+  memset(&anchors, 0, sizeof(anchors));
+
+  if (front)
+    anchor_build(&anchors, front);
+
+  for (i = num_files, file = files; i > 0; i --, file ++)
+  {
+    if (!file->front)
+      anchor_build(&anchors, file);
+  }
+
   //
   // Generate a table of contents...
 //
 
   if (toc_levels > 0)
   {
-    for (i = 0; i < num_files; i ++)
-      num_toc = build_toc(files[i], toc_levels, num_toc, &toc);
+    for (i = num_files, file = files; i > 0; i --, file ++)
+    {
+      if (!file->front)
+	num_toc = build_toc(file, toc_levels, num_toc, &toc);
+    }
   }
 
   //
@@ -303,13 +423,16 @@ main(int  argc,				// I - Number of command-line arguments
 	  html_titlepage(outfp, coverfile, title, copyright, author, version);
 
 	if (front)
-	  html_block(outfp, front);
+	  write_file(outfp, front, format);
 
 	if (num_toc)
 	  html_toc(outfp, num_toc, toc);
 
 	for (i = 0; i < num_files; i ++)
-	  html_block(outfp, files[i]);
+	{
+	  if (!files[i].front)
+	    write_file(outfp, files + i, format);
+	}
 
 	fputs("	 </body>\n", outfp);
 	fputs("</html>\n", outfp);
@@ -319,10 +442,13 @@ main(int  argc,				// I - Number of command-line arguments
 	man_head(outfp, section, title, copyright, author, version);
 
 	if (front)
-	  man_block(outfp, front);
+	  write_file(outfp, front, format);
 
 	for (i = 0; i < num_files; i ++)
-	  man_block(outfp, files[i]);
+	{
+	  if (!files[i].front)
+	    write_file(outfp, files + i, format);
+	}
 
 	if (copyright)
 	{
@@ -336,79 +462,462 @@ main(int  argc,				// I - Number of command-line arguments
   if (outfp != stdout)
     fclose(outfp);
 
+  // Free the documents before the string table they use...
+  for (i = num_files, file = files; i > 0; i --, file ++)
+    mmdFree(file->doc);
+
+  mmdStringsFree(strings);
+
   return (0);
 }
 
 
 //
-// 'build_toc()' - Scan for headings to include in the table of contents.
+// 'add_toc()' - Add a table of contents entry.
 //
 
 static int				// O  - Number of table of contents entries
-build_toc(mmd_t *parent,		// I  - Parent node
-	  int	toc_levels,		// I  - Number of levels in table of contents
-	  int	num_toc,		// I  - Number of table of contents entries
-	  toc_t **toc)			// IO - Table of contents entries
+add_toc(int   num_toc,			// I  - Number of table of contents entries
+        toc_t **toc,			// IO - Table of contents entries
+        int   level,			// I  - Heading level
+        char  *heading,			// I  - Heading text (allocated)
+        char  *anchor)			// I  - Anchor string (allocated)
 {
-  mmd_t		*node,			// Current node
-		*next;			// Next node
-  mmd_type_t	type;			// Node type
   toc_t		*temp;			// Table of contents entry
-  int		alloc_toc = num_toc;	// Allocated entries
 
 
-  for (node = mmdGetFirstChild(parent); node; node = next)
+  // Double the size of the array as needed: 16, 32, 64, ...
+  if (num_toc == 0 || (num_toc >= 16 && (num_toc & (num_toc - 1)) == 0))
   {
-    type = mmdGetType(node);
-
-    if (type >= MMD_TYPE_HEADING_1 && type <= MMD_TYPE_HEADING_6 && (type - MMD_TYPE_HEADING_1) < toc_levels)
+    if ((temp = realloc(*toc, (size_t)(num_toc ? 2 * num_toc : 16) * sizeof(toc_t))) == NULL)
     {
-      if (num_toc >= alloc_toc)
-      {
-	alloc_toc += 10;
-	if ((temp = realloc(*toc, alloc_toc * sizeof(toc_t))) == NULL)
-	{
-	  fputs("mmdutil: Unable to allocate memory for table of contents.\n", stderr);
-	  exit(1);
-	}
+      fputs("mmdutil: Unable to allocate memory for table of contents.\n", stderr);
+      exit(1);
+    }
+
+    *toc = temp;
+  }
+
+  temp = *toc + num_toc;
+
+  temp->heading = heading;
+  temp->anchor  = anchor;
+  temp->level   = level;
+
+  return (num_toc + 1);
+}
 
-	*toc = temp;
-      }
 
-      temp = *toc + num_toc;
-      num_toc ++;
+//
+// 'anchor_add()' - Add an anchor to the hash table.
+//
+
+static void
+anchor_add(anchors_t  *anchors,		// I - Heading anchors
+           const char *name)		// I - Anchor string
+{
+  size_t	i,			// Looping var
+		hash,			// Hash index
+		hash_size;		// Old size of hash table
+  anchor_t	*by_name,		// Old hash table
+		*anchor;		// Current anchor
 
-      temp->heading = mmdCopyAllText(node);
-      temp->level   = type - MMD_TYPE_HEADING_1 + 1;
+
+  // Double the size of the hash table as needed to keep it at most half full...
+  if (2 * (anchors->num_anchors + 1) > anchors->hash_size)
+  {
+    hash_size = anchors->hash_size;
+    by_name   = anchors->by_name;
+
+    anchors->hash_size = hash_size ? 2 * hash_size : 64;
+
+    if ((anchors->by_name = calloc(anchors->hash_size, sizeof(anchor_t))) == NULL)
+    {
+      fputs("mmdutil: Unable to allocate memory for heading anchors.\n", stderr);
+      exit(1);
     }
 
-    if ((next = mmdGetNextSibling(node)) == NULL)
+    for (i = hash_size, anchor = by_name; i > 0; i --, anchor ++)
     {
-      next = mmdGetParent(node);
+      if (!anchor->anchor)
+        continue;
+
+      for (hash = anchor_hash(anchors, anchor->anchor); anchors->by_name[hash].anchor; hash = (hash + 1) & (anchors->hash_size - 1));
+      anchors->by_name[hash] = *anchor;
+    }
+
+    free(by_name);
+  }
+
+  for (hash = anchor_hash(anchors, name); anchors->by_name[hash].anchor; hash = (hash + 1) & (anchors->hash_size - 1));
+
+  anchors->by_name[hash].anchor = name;
+  anchors->by_name[hash].suffix = 2;
+  anchors->num_anchors ++;
+}
 
-      while (next && mmdGetNextSibling(next) == NULL)
-	next = mmdGetParent(next);
 
-      next = mmdGetNextSibling(next);
+//
+// 'anchor_build()' - Compute unique anchors for all headings in a file.
+//
+// Files are added in output order.  The first heading using a given anchor
+// string keeps it so that "@" links resolve without a lookup, while later
+// duplicates, in this file or any earlier one, get a "-N" suffix that no other
+// heading uses.
+//
+
+static void
+anchor_build(anchors_t *anchors,	// I - Heading anchors of earlier files
+             file_t    *file)		// I - Input file
+{
+  int		i;			// Looping var
+  toc_t		*heading;		// Current heading
+  anchor_t	*first;			// First anchor with the same string
+  char		unique[1040];		// Unique anchor string
+
+
+  // The first heading with a given anchor keeps it...
+  for (i = file->num_headings, heading = file->headings; i > 0; i --, heading ++)
+  {
+    if (!anchor_find(anchors, heading->anchor))
+      anchor_add(anchors, heading->anchor);
+  }
+
+  // Then give any duplicates a unique suffix...
+  for (i = file->num_headings, heading = file->headings; i > 0; i --, heading ++)
+  {
+    first = anchor_find(anchors, heading->anchor);
+    if (first->anchor == heading->anchor)
+      continue;
+
+    // Continue from the last suffix used so repeated headings stay linear...
+    do
+    {
+      snprintf(unique, sizeof(unique), "%s-%u", heading->anchor, first->suffix ++);
+    }
+    while (anchor_find(anchors, unique));
+
+    free(heading->anchor);
+    if ((heading->anchor = strdup(unique)) == NULL)
+    {
+      fputs("mmdutil: Unable to allocate memory for heading anchors.\n", stderr);
+      exit(1);
     }
+
+    anchor_add(anchors, heading->anchor);
+  }
+}
+
+
+//
+// 'anchor_find()' - Find an anchor by anchor string.
+//
+
+static anchor_t *			// O - Anchor or `NULL` if not found
+anchor_find(anchors_t  *anchors,	// I - Heading anchors
+            const char *name)		// I - Anchor string
+{
+  size_t	hash;			// Hash index
+  anchor_t	*anchor;		// Current anchor
+
+
+  if (!anchors->hash_size)
+    return (NULL);
+
+  for (hash = anchor_hash(anchors, name); (anchor = anchors->by_name + hash)->anchor != NULL; hash = (hash + 1) & (anchors->hash_size - 1))
+  {
+    if (!strcmp(anchor->anchor, name))
+      return (anchor);
+  }
+
+  return (NULL);
+}
+
+
+//
+// 'anchor_hash()' - Compute the hash index for an anchor string.
+//
+
+static size_t				// O - Hash index
+anchor_hash(anchors_t  *anchors,	// I - Heading anchors
+            const char *name)		// I - Anchor string
+{
+  uint64_t	hash;			// Hash value
+
+
+  for (hash = 0xcbf29ce484222325ULL; *name; name ++)
+    hash = (hash ^ (unsigned char)*name) * 0x100000001b3ULL;
+
+  return ((size_t)hash & (anchors->hash_size - 1));
+}
+
+
+//
+// 'build_toc()' - Collect the top-level headings to include in the table of
+//                 contents.
+//
+
+static int				// O  - Number of table of contents entries
+build_toc(file_t *file,			// I  - Input file
+	  int    toc_levels,		// I  - Number of levels in table of contents
+	  int    num_toc,		// I  - Number of table of contents entries
+	  toc_t  **toc)			// IO - Table of contents entries
+{
+  int		i;			// Looping var
+  toc_t		*heading;		// Current heading
+
+
+  for (i = file->num_headings, heading = file->headings; i > 0; i --, heading ++)
+  {
+    if (heading->top && heading->level <= toc_levels)
+      num_toc = add_toc(num_toc, toc, heading->level, strdup(heading->heading), strdup(heading->anchor));
   }
 
   return (num_toc);
 }
 
 
+//
+// 'cache_gets()' - Read a length-prefixed string from a cache file.
+//
+
+static char *				// O  - String or `NULL` if none
+cache_gets(FILE *fp,			// I  - Cache file
+           bool *error)			// IO - Set to `true` on error
+{
+  int	len;				// Length of string
+  char	*s;				// String
+
+
+  if (fscanf(fp, "%d", &len) != 1 || getc(fp) != ' ' || len > 65536)
+  {
+    *error = true;
+    return (NULL);
+  }
+  else if (len < 0)
+  {
+    if (getc(fp) != '\n')
+      *error = true;
+
+    return (NULL);
+  }
+
+  if ((s = malloc((size_t)len + 1)) == NULL || fread(s, 1, (size_t)len, fp) != (size_t)len || getc(fp) != '\n')
+  {
+    free(s);
+    *error = true;
+    return (NULL);
+  }
+
+  s[len] = '\0';
+
+  return (s);
+}
+
+
+//
+// 'cache_hash()' - Compute the cache key for a markdown file.
+//
+// The key is a 64-bit FNV-1a hash of the cache format/version, the output
+// format, and the markdown text.
+//
+
+static uint64_t				// O - Hash
+cache_hash(const char *buffer,		// I - Markdown text
+           size_t     bytes,		// I - Length of markdown text
+           format_t   format)		// I - Output format
+{
+  uint64_t	hash = 0xcbf29ce484222325ULL;
+					// FNV-1a hash
+  const char	*magic = CACHE_MAGIC;	// Cache format/version
+
+
+  for (; *magic; magic ++)
+    hash = (hash ^ (unsigned char)*magic) * 0x100000001b3ULL;
+
+  hash = (hash ^ (unsigned char)format) * 0x100000001b3ULL;
+
+  for (; bytes > 0; bytes --, buffer ++)
+    hash = (hash ^ (unsigned char)*buffer) * 0x100000001b3ULL;
+
+  return (hash);
+}
+
+
+//
+// 'cache_puts()' - Write a length-prefixed string to a cache file.
+//
+
+static void
+cache_puts(FILE       *fp,		// I - Cache file
+           const char *s)		// I - String or `NULL`
+{
+  if (s)
+    fprintf(fp, "%d %s\n", (int)strlen(s), s);
+  else
+    fputs("-1 \n", fp);
+}
+
+
+//
+// 'cache_read()' - Read the metadata and headings from a cache file.
+//
+// On success the rendered output starts at `file->cachepos` in the cache file.
+//
+
+static bool				// O - `true` on success, `false` on miss/error
+cache_read(file_t *file)		// I - Input file
+{
+  FILE		*fp;			// Cache file
+  char		line[256];		// Line from file
+  bool		error = false;		// Read error?
+  int		i,			// Looping var
+		top;			// Top-level heading?
+  toc_t		*heading;		// Current heading
+
+
+  if ((fp = fopen(file->cachefile, "rb")) == NULL)
+    return (false);
+
+  if (!fgets(line, sizeof(line), fp) || strcmp(line, CACHE_MAGIC "\n"))
+  {
+    fclose(fp);
+    return (false);
+  }
+
+  file->title     = cache_gets(fp, &error);
+  file->author    = cache_gets(fp, &error);
+  file->copyright = cache_gets(fp, &error);
+  file->version   = cache_gets(fp, &error);
+
+  if (error || fscanf(fp, "%d", &file->num_headings) != 1 || getc(fp) != '\n' || file->num_headings < 0 || file->num_headings > 65536)
+  {
+    file->num_headings = 0;
+    error              = true;
+  }
+  else if (file->num_headings > 0 && (file->headings = calloc((size_t)file->num_headings, sizeof(toc_t))) == NULL)
+  {
+    error = true;
+  }
+
+  for (i = file->num_headings, heading = file->headings; i > 0 && !error; i --, heading ++)
+  {
+    if (fscanf(fp, "%d%d", &heading->level, &top) != 2 || getc(fp) != ' ')
+      error = true;
+    else
+    {
+      heading->top     = top != 0;
+      heading->heading = cache_gets(fp, &error);
+      heading->anchor  = cache_gets(fp, &error);
+    }
+  }
+
+  file->cachepos = ftell(fp);
+
+  fclose(fp);
+
+  if (error)
+  {
+    // Ignore bad cache files - they will be replaced...
+    free((char *)file->title);
+    free((char *)file->author);
+    free((char *)file->copyright);
+    free((char *)file->version);
+
+    for (i = 0; i < file->num_headings && file->headings; i ++)
+    {
+      free(file->headings[i].heading);
+      free(file->headings[i].anchor);
+    }
+    free(file->headings);
+
+    file->title        = NULL;
+    file->author       = NULL;
+    file->copyright    = NULL;
+    file->version      = NULL;
+    file->num_headings = 0;
+    file->headings     = NULL;
+
+    return (false);
+  }
+
+  return (true);
+}
+
+
+//
+// 'cache_write()' - Write the metadata, headings, and rendered output to a
+//                   cache file.
+//
+
+static bool				// O - `true` on success, `false` on error
+cache_write(file_t   *file,		// I - Input file
+            format_t format)		// I - Output format
+{
+  FILE		*fp;			// Cache file
+  char		tempfile[1040];		// Temporary filename
+  int		i;			// Looping var
+  toc_t		*heading;		// Current heading
+  bool		ret;			// Return value
+
+
+  // Write to a temporary file and then rename it so that other programs never
+  // see a partial cache file...
+  snprintf(tempfile, sizeof(tempfile), "%s.tmp", file->cachefile);
+
+  if ((fp = fopen(tempfile, "wb")) == NULL)
+    return (false);
+
+  fputs(CACHE_MAGIC "\n", fp);
+  cache_puts(fp, file->title);
+  cache_puts(fp, file->author);
+  cache_puts(fp, file->copyright);
+  cache_puts(fp, file->version);
+
+  // Save all headings with their base anchors so the same cache file works
+  // for any "--toc" value and any other files...
+  fprintf(fp, "%d\n", file->num_headings);
+  for (i = file->num_headings, heading = file->headings; i > 0; i --, heading ++)
+  {
+    fprintf(fp, "%d %d ", heading->level, heading->top ? 1 : 0);
+    cache_puts(fp, heading->heading);
+    cache_puts(fp, heading->anchor);
+  }
+
+  // The heading anchors are filled in by write_file...
+  if (format == FORMAT_HTML)
+    html_block(fp, NULL, file->doc);
+  else
+    man_block(fp, file->doc);
+
+  ret = !ferror(fp);
+
+  if (fclose(fp))
+    ret = false;
+
+  if (ret && rename(tempfile, file->cachefile))
+    ret = false;
+
+  if (!ret)
+    remove(tempfile);
+
+  return (ret);
+}
+
+
 //
 // 'html_anchor()' - Make an anchor for internal links.
 //
 
-static const char *			// O - Anchor string
-html_anchor(const char *text)		// I - Text
+static char *				// O - Anchor string
+html_anchor(const char *text,		// I - Text
+            char       *buffer,		// I - Anchor buffer
+            size_t     bufsize)		// I - Size of anchor buffer
 {
   char		*bufptr;		// Pointer into buffer
-  static char	buffer[1024];		// Buffer for anchor string
 
 
-  for (bufptr = buffer; *text && bufptr < (buffer + sizeof(buffer) - 1); text ++)
+  for (bufptr = buffer; *text && bufptr < (buffer + bufsize - 1); text ++)
   {
     if ((*text >= '0' && *text <= '9') || (*text >= 'a' && *text <= 'z') || (*text >= 'A' && *text <= 'Z') || *text == '.' || *text == '-')
       *bufptr++ = tolower(*text);
@@ -427,8 +936,9 @@ html_anchor(const char *text)		// I - Text
 //
 
 static void
-html_block(FILE	 *outfp,		// I - Output file
-	   mmd_t *parent)		// I - Parent node
+html_block(FILE	  *outfp,		// I - Output file
+	   file_t *file,		// I - Input file or `NULL` for anchor markers
+	   mmd_t  *parent)		// I - Parent node
 {
   const char	*element,		// Enclosing element, if any
 		*hclass = NULL;		// HTML class, if any
@@ -538,15 +1048,13 @@ html_block(FILE	 *outfp,		// I - Output file
 
   if (type >= MMD_TYPE_HEADING_1 && type <= MMD_TYPE_HEADING_6)
   {
-    // Add an anchor for each heading...
+    // Add an anchor for each heading, in document order, or a nul marker for
+    // cached output...
     fprintf(outfp, "	<%s id=\"", element);
-    for (node = mmdGetFirstChild(parent); node; node = mmdGetNextSibling(node))
-    {
-      if (mmdGetWhitespace(node))
-	putc('-', outfp);
-
-      fputs(html_anchor(mmdGetText(node)), outfp);
-    }
+    if (!file)
+      putc('\0', outfp);
+    else if (file->cur_heading < file->num_headings)
+      fputs(file->headings[file->cur_heading ++].anchor, outfp);
     fputs("\">", outfp);
   }
   else if (element)
@@ -556,7 +1064,7 @@ html_block(FILE	 *outfp,		// I - Output file
   {
     if (mmdIsBlock(node))
     {
-      html_block(outfp, node);
+      html_block(outfp, file, node);
     }
     else
       html_leaf(outfp, node);
@@ -710,6 +1218,7 @@ html_leaf(FILE	*outfp,			// I - Output file
   const char	*element,		// Encoding element, if any
 		*text,			// Text to write
 		*url;			// URL to write
+  char		anchor[1024];		// Anchor string for "@" links
 
 
   if (mmdGetWhitespace(node))
@@ -777,10 +1286,10 @@ html_leaf(FILE	*outfp,			// I - Output file
     const char *prev_url = mmdGetURL(mmdGetPrevSibling(node));
     const char *title = mmdGetExtra(node);
 
-    if (!prev_url || strcmp(prev_url, url))
+    if (prev_url != url && (!prev_url || strcmp(prev_url, url)))
     {
       if (!strcmp(url, "@"))
-	fprintf(outfp, "<a href=\"#%s\"", html_anchor(text));
+	fprintf(outfp, "<a href=\"#%s\"", html_anchor(text, anchor, sizeof(anchor)));
       else
 	fprintf(outfp, "<a href=\"%s\"", url);
 
@@ -814,7 +1323,7 @@ html_leaf(FILE	*outfp,			// I - Output file
   {
     const char *next_url = mmdGetURL(mmdGetNextSibling(node));
 
-    if (!next_url || strcmp(next_url, url))
+    if (next_url != url && (!next_url || strcmp(next_url, url)))
       fputs("</a>", outfp);
   }
 }
@@ -828,21 +1337,30 @@ static void
 html_puts(FILE	     *outfp,		// I - Output file
 	  const char *text)		// I - Text string
 {
+  size_t	len;			// Length of plain text
+
+
   if (!text)
     return;
 
   while (*text)
   {
+    // Write runs of plain text all at once...
+    if ((len = strcspn(text, "&<>\"")) > 0)
+    {
+      fwrite(text, 1, len, outfp);
+      text += len;
+      continue;
+    }
+
     if (*text == '&')
       fputs("&amp;", outfp);
     else if (*text == '<')
       fputs("&lt;", outfp);
     else if (*text == '>')
       fputs("&gt;", outfp);
-    else if (*text == '\"')
-      fputs("&quot;", outfp);
     else
-      putc(*text, outfp);
+      fputs("&quot;", outfp);
 
     text ++;
   }
@@ -918,7 +1436,7 @@ html_toc(FILE  *outfp,			// I - Output file
       fprintf(outfp, "%*s</ul></li>\n", level * 2 + 4, "");
     }
 
-    fprintf(outfp, "%*s<li class=\"toc\"><a href=\"#%s\">", level * 2 + 4, "", html_anchor(toc->heading));
+    fprintf(outfp, "%*s<li class=\"toc\"><a href=\"#%s\">", level * 2 + 4, "", toc->anchor);
     html_puts(outfp, toc->heading);
 
     num_toc --;
@@ -953,6 +1471,134 @@ html_toc(FILE  *outfp,			// I - Output file
 }
 
 
+//
+// 'load_file()' - Load an input file or its cached output.
+//
+
+static bool				// O - `true` on success, `false` on error
+load_file(file_t        *file,		// I - Input file
+          const char    *cachedir,	// I - Cache directory or `NULL` for none
+          format_t      format,		// I - Output format
+          mmd_strings_t *strings)	// I - String table
+{
+  char		*buffer = NULL;		// Markdown text
+  size_t	bytes;			// Length of markdown text
+  mmd_t		*doc;			// Document
+
+
+  if (cachedir)
+  {
+    // Look for cached output using the hash of the file's contents...
+    if ((buffer = read_file(file->filename, &bytes)) == NULL)
+    {
+      fprintf(stderr, "mmdutil: Unable to load \"%s\": %s\n", file->filename, strerror(errno));
+      return (false);
+    }
+
+    snprintf(file->cachefile, sizeof(file->cachefile), "%s/%016llx-%lu.%s", cachedir, (unsigned long long)cache_hash(buffer, bytes, format), (unsigned long)bytes, format == FORMAT_HTML ? "html" : "man");
+
+    if (cache_read(file))
+    {
+      free(buffer);
+      return (true);
+    }
+  }
+
+  // Load the file into a document that uses the shared string table...
+  if ((doc = mmdNew(NULL, NULL)) != NULL)
+  {
+    mmdSetStrings(doc, strings);
+
+    if (buffer)
+      file->doc = mmdLoadParallel(doc, buffer, bytes, 0);
+    else if (!strcmp(file->filename, "-"))
+      file->doc = mmdLoadFile(doc, stdin);
+    else
+      file->doc = mmdLoad(doc, file->filename);
+  }
+
+  if (!file->doc)
+  {
+    fprintf(stderr, "mmdutil: Unable to load \"%s\": %s\n", file->filename, strerror(errno));
+    mmdFree(doc);
+    free(buffer);
+    return (false);
+  }
+
+  load_headings(file);
+
+  file->title     = mmdGetMetadata(file->doc, "title");
+  file->author    = mmdGetMetadata(file->doc, "author");
+  file->copyright = mmdGetMetadata(file->doc, "copyright");
+  file->version   = mmdGetMetadata(file->doc, "version");
+
+  if (buffer)
+  {
+    free(buffer);
+
+    if (!cache_write(file, format))
+      fprintf(stderr, "mmdutil: Unable to cache \"%s\": %s\n", file->filename, strerror(errno));
+  }
+
+  return (true);
+}
+
+
+//
+// 'load_headings()' - Get the headings of a loaded file with their base
+//                     anchors.
+//
+
+static void
+load_headings(file_t *file)		// I - Input file
+{
+  const mmd_heading_t *headings;	// Document outline
+  size_t	num_headings;		// Number of headings
+  mmd_t		*child;			// Child node
+  const char	*text;			// Text of child node
+  toc_t		*heading;		// Current heading
+  char		buffer[1024],		// Anchor string
+		*bufptr;		// Pointer into anchor string
+
+
+  if ((headings = mmdGetOutline(file->doc, &num_headings)) == NULL)
+    return;
+
+  if ((file->headings = calloc(num_headings, sizeof(toc_t))) == NULL)
+  {
+    fputs("mmdutil: Unable to allocate memory for headings.\n", stderr);
+    exit(1);
+  }
+
+  file->num_headings = (int)num_headings;
+
+  for (heading = file->headings; num_headings > 0; num_headings --, heading ++, headings ++)
+  {
+    for (bufptr = buffer, *bufptr = '\0', child = mmdGetFirstChild(headings->node); child; child = mmdGetNextSibling(child))
+    {
+      if (mmdGetWhitespace(child) && bufptr < (buffer + sizeof(buffer) - 1))
+	*bufptr++ = '-';
+
+      if ((text = mmdGetText(child)) != NULL)
+	html_anchor(text, bufptr, sizeof(buffer) - (size_t)(bufptr - buffer));
+
+      bufptr += strlen(bufptr);
+    }
+
+    heading->level   = headings->level;
+    heading->top     = !mmdGetParent(mmdGetParent(headings->node));
+    heading->heading = strdup(headings->text);
+    heading->anchor  = strdup(buffer);
+
+    if (!heading->heading || !heading->anchor)
+    {
+      fputs("mmdutil: Unable to allocate memory for headings.\n", stderr);
+      exit(1);
+    }
+  }
+}
+
+
 //
 // 'man_block()' - Write a block node as man page source.
 //
@@ -1002,10 +1648,7 @@ man_block(FILE	 *outfp,		// I - Output file
     case MMD_TYPE_CODE_BLOCK :
 	fputs(".nf\n\n", outfp);
 	for (node = mmdGetFirstChild(parent); node; node = mmdGetNextSibling(node))
-	{
-	  fputs("    ", outfp);
-	  man_puts(outfp, mmdGetText(node), 0);
-	}
+	  man_code(outfp, mmdGetText(node));
 	fputs(".fi\n", outfp);
 	return;
 
@@ -1033,6 +1676,43 @@ man_block(FILE	 *outfp,		// I - Output file
 }
 
 
+//
+// 'man_code()' - Write indented lines of code.
+//
+
+static void
+man_code(FILE       *outfp,		// I - Output file
+         const char *s)			// I - Code text
+{
+  char	*copy,				// Copy of code text
+	*line,				// Current line
+	*next;				// Next line
+
+
+  if (!s || (copy = strdup(s)) == NULL)
+    return;
+
+  for (line = copy; *line; line = next)
+  {
+    fputs("    ", outfp);
+
+    if ((next = strchr(line, '\n')) == NULL)
+    {
+      // Last line without a newline...
+      man_puts(outfp, line, 0);
+      break;
+    }
+
+    *next++ = '\0';
+
+    man_puts(outfp, line, 0);
+    putc('\n', outfp);
+  }
+
+  free(copy);
+}
+
+
 //
 // 'man_head()' - Write man page header.
 //
@@ -1136,24 +1816,63 @@ man_leaf(FILE  *outfp,			// I - Output file
 //
 // 'man_puts()' - Write a string as safe man page source.
 //
+// The escaped string is collected in a local buffer so that runs of plain
+// ASCII characters are copied in bulk and the output file is written once per
+// buffer instead of once per character.
+//
 
 static void
 man_puts(FILE       *outfp,		// I - Output file
          const char *s,			// I - Text string
          int        allcaps)		// I - Output in all caps?
 {
-  int	ch;				// Character
+  int		ch;			// Character
+  const char	*start;			// Start of plain ASCII run
+  char		buffer[8192],		// Output buffer
+		*bufptr = buffer,	// Pointer into buffer
+		*bufend = buffer + sizeof(buffer) - 16;
+					// End of buffer (room for one escape)
+  size_t	len;			// Length of plain ASCII run
+  static const char escapes[128] =	// Characters needing a backslash
+  {
+    ['-']  = 1,
+    ['\\'] = 1
+  };
 
 
   while (*s)
   {
-    if ((*s & 0xe0) == 0xc0 && (s[1] & 0x80))
+    if (bufptr >= bufend)
+    {
+      fwrite(buffer, 1, (size_t)(bufptr - buffer), outfp);
+      bufptr = buffer;
+    }
+
+    if ((*s & 0x80) == 0 && !escapes[(int)*s])
+    {
+      // Copy a run of plain ASCII characters...
+      for (start = s, s ++; (*s & 0x80) == 0 && *s && !escapes[(int)*s] && s < (start + (bufend - bufptr)); s ++);
+
+      len = (size_t)(s - start);
+
+      if (allcaps)
+      {
+        for (; start < s; start ++)
+          *bufptr++ = (*start >= 'a' && *start <= 'z') ? *start - 'a' + 'A' : *start;
+      }
+      else
+      {
+	memcpy(bufptr, start, len);
+	bufptr += len;
+      }
+    }
+    else if ((*s & 0xe0) == 0xc0 && (s[1] & 0x80))
     {
       // 2-byte UTF-8...
       ch = ((*s & 0x1f) << 6) | (s[1] & 0x3f);
       s += 2;
 
-      fprintf(outfp, "\\[u%04X]", ch);
+      bufptr += snprintf(bufptr, 16, "\\[u%04X]", ch);
     }
     else if ((*s & 0xf0) == 0xe0 && (s[1] & 0x80) && (s[2] & 0x80))
     {
@@ -1161,7 +1880,7 @@ man_puts(FILE       *outfp,		// I - Output file
       ch = ((((*s & 0x1f) << 6) | (s[1] & 0x3f)) << 6) | (s[2] & 0x3f);
       s += 3;
 
-      fprintf(outfp, "\\[u%04X]", ch);
+      bufptr += snprintf(bufptr, 16, "\\[u%04X]", ch);
     }
     else if ((*s & 0xf8) == 0xf0 && (s[1] & 0x80) && (s[2] & 0x80) && (s[3] & 0x80))
     {
@@ -1169,19 +1888,76 @@ man_puts(FILE       *outfp,		// I - Output file
       ch = ((((((*s & 0x1f) << 6) | (s[1] & 0x3f)) << 6) | (s[2] & 0x3f)) << 6) | (s[3] & 0x3f);
       s += 4;
 
-      fprintf(outfp, "\\[u%04X]", ch);
+      bufptr += snprintf(bufptr, 16, "\\[u%04X]", ch);
     }
     else
     {
+      // Escaped ASCII or a stray non-ASCII byte...
       if (*s == '\\' || *s == '-')
-	putc('\\', outfp);
+	*bufptr++ = '\\';
 
-      if (allcaps)
-        putc(toupper(*s++), outfp);
-      else
-	putc(*s++, outfp);
+      *bufptr++ = *s++;
     }
   }
+
+  if (bufptr > buffer)
+    fwrite(buffer, 1, (size_t)(bufptr - buffer), outfp);
+}
+
+
+//
+// 'read_file()' - Read a file into memory.
+//
+
+static char *				// O - File contents or `NULL` on error
+read_file(const char *filename,		// I - Filename or "-" for stdin
+          size_t     *bytes)		// O - Number of bytes
+{
+  FILE		*fp;			// File
+  char		*buffer = NULL,		// File contents
+		*temp;			// New buffer
+  size_t	alloc = 0,		// Allocated bytes
+		rbytes;			// Bytes read
+
+
+  *bytes = 0;
+
+  if (!strcmp(filename, "-"))
+    fp = stdin;
+  else if ((fp = fopen(filename, "rb")) == NULL)
+    return (NULL);
+
+  do
+  {
+    if (*bytes >= alloc)
+    {
+      alloc = alloc ? 2 * alloc : 65536;
+
+      if ((temp = realloc(buffer, alloc)) == NULL)
+      {
+        free(buffer);
+        buffer = NULL;
+        break;
+      }
+
+      buffer = temp;
+    }
+
+    rbytes = fread(buffer + *bytes, 1, alloc - *bytes, fp);
+    *bytes += rbytes;
+  }
+  while (rbytes > 0);
+
+  if (buffer && ferror(fp))
+  {
+    free(buffer);
+    buffer = NULL;
+  }
+
+  if (fp != stdin)
+    fclose(fp);
+
+  return (buffer);
 }
 
 
@@ -1194,6 +1970,7 @@ usage(void)
 {
   puts("Usage: mmdutil [options] filename.md [... filenameN.md]");
   puts("Options:");
+  puts("  --cache-dir dirname	      Cache rendered output in the specified directory.");
   puts("  --cover filename.jpg	      Specify cover image.");
   puts("  --css filename.css	      Specify style sheet.");
   puts("  --front filename.md	      Specify frontmatter file.");
@@ -1203,3 +1980,57 @@ usage(void)
   puts("  --version		      Show version.");
   puts("  -o filename.html	      Specify output filename.");
 }
+
+
+//
+// 'write_file()' - Write the rendered output for an input file.
+//
+
+static void
+write_file(FILE     *outfp,		// I - Output file
+           file_t   *file,		// I - Input file
+           format_t format)		// I - Output format
+{
+  FILE		*fp;			// Cache file
+  char		buffer[8192],		// Copy buffer
+		*bufptr,		// Pointer into buffer
+		*bufend,		// End of buffer
+		*marker;		// Heading anchor marker
+  size_t	bytes;			// Bytes read
+
+
+  file->cur_heading = 0;
+
+  if (file->doc)
+  {
+    if (format == FORMAT_HTML)
+      html_block(outfp, file, file->doc);
+    else
+      man_block(outfp, file->doc);
+  }
+  else if ((fp = fopen(file->cachefile, "rb")) != NULL)
+  {
+    if (!fseek(fp, file->cachepos, SEEK_SET))
+    {
+      while ((bytes = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+      {
+        // Replace each nul marker with the next heading anchor...
+        for (bufptr = buffer, bufend = buffer + bytes; (marker = memchr(bufptr, '\0', (size_t)(bufend - bufptr))) != NULL; bufptr = marker + 1)
+        {
+          fwrite(bufptr, 1, (size_t)(marker - bufptr), outfp);
+
+          if (file->cur_heading < file->num_headings)
+            fputs(file->headings[file->cur_heading ++].anchor, outfp);
+        }
+
+        fwrite(bufptr, 1, (size_t)(bufend - bufptr), outfp);
+      }
+    }
+
+    fclose(fp);
+  }
+  else
+  {
+    fprintf(stderr, "mmdutil: Unable to open cache file \"%s\": %s\n", file->cachefile, strerror(errno));
+  }
+}
@@ -5,8 +5,12 @@
 //
 // Usage:
 //
-//     ./testmmd [--ext {all,none}] [--help] [--only-body] [--spec]
-//               [-o filename.html] filename.md
+//     ./testmmd [--allocator] [--binary] [--blocks] [--code-text]
+//               [--complexity] [--ext {all,none}] [--feed N] [--freeze]
+//               [--help] [--index] [--lazy] [--limit name=value]
+//               [--metadata] [--only-body] [--outline] [--reload] [--spec]
+//               [--stats] [--strings] [--threads N] [-o filename.html]
+//               filename.md
 //
 // Copyright © 2017-2024 by Michael R Sweet.
 //
@@ -18,14 +22,47 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
 
 
 //
 // Local globals...
 //
 
+static size_t		alloc_count = 0;	// Number of outstanding allocations
 static bool		spec_mode = false;
 					// Output HTML according to the CommonMark spec
+static const struct
+{
+  const char	*name,			// Name of input shape
+		*prefix,		// Text before repeated text
+		*repeat,		// Repeated text ("%u" is replaced by a number)
+		*suffix;		// Text after repeated text
+  size_t	blocks,			// Number of blocks
+		count;			// Repeat count for N
+}			complexity_shapes[] =
+{					// Pathological input shapes (blocks stay under 8k at 4N)
+  { "escapes", "", "\\*", "", 1500, 1000 },
+  { "link-url-escapes", "[link](", "\\)", ")", 3000, 1000 },
+  { "link-title-escapes", "[link](url \"", "\\\"", "\")", 4000, 1000 },
+  { "reference-escapes", "[ref]: url", "\\!", "", 3000, 1000 },
+  { "fence-language-escapes", "```", "\\!", "\n```", 3000, 1000 },
+  { "unmatched-autolink", "", "<a", "", 1000, 1000 },
+  { "asterisk-run", "a", "*", "a", 1000, 1000 },
+  { "underscore-run", "a", "_", "a", 1000, 1000 },
+  { "bracket-run", "a", "[", "a", 8000, 1000 },
+  { "angle-run", "a", "<", "a", 2000, 1000 },
+  { "unmatched-emphasis", "", "*a _b\n", "", 1000, 300 },
+  { "unmatched-links", "", "[a ![b\n", "", 1500, 250 },
+  { "deep-block-quotes", "", "> ", "a", 1000, 1000 },
+  { "reference-definitions", "", "[r%u]: http://r\n\n", "", 50, 1000 },
+  { "reference-links", "[r]: http://r\n\n", "[r] ", "", 750, 400 },
+  { "pending-links", "", "[r%u]\n", "\n[r]: http://r", 1000, 150 },
+  { "table-rows", "| a | b |\n|---|---|\n", "| c | d |\n", "", 50, 1000 },
+  { "list-items", "", "- item\n", "", 80, 1000 },
+  { "continuation-lines", "", "text\n", "", 500, 350 },
+  { "block-quote-lines", "", "> text\n", "", 500, 350 }
+};
 
 
 //
@@ -33,14 +70,28 @@ static bool		spec_mode = false;
 //
 
 static void		add_spec_text(char *dst, const char *src, size_t dstsize);
+static void		*alloc_cb(size_t *count, void *ptr, size_t bytes);
+static void		block_cb(FILE *fp, mmd_t *block);
+static bool		check_index(mmd_t *doc);
+static bool		check_metadata(mmd_t *doc, const char *filename);
+static bool		check_outline(mmd_t *doc, bool allocator);
+static bool		check_strings(mmd_t *doc);
 static void		indent_puts(FILE *logfile, const char *text, int cursor);
 static int		is_equal(const char *generated, const char *expected, int *failed_at);
+static mmd_t		*load_feed(mmd_t *root, const char *filename, size_t feed_bytes);
+static mmd_t		*load_parallel(mmd_t *root, const char *filename, int num_threads);
 static const char	*make_anchor(const char *text);
+static mmd_t		*next_node(mmd_t *doc, mmd_t *node);
+static mmd_t		*reload_binary(mmd_t *doc);
+static mmd_t		*reload_nodes(mmd_t *doc, const char *filename);
+static int		run_complexity(FILE *logfile);
 static int		run_spec(const char *filename, FILE *logfile);
+static double		time_load(size_t shape, size_t count);
 static void		usage(void);
 static void		write_block(FILE *fp, mmd_t *parent);
 static void		write_html(FILE *fp, const char *s);
 static void		write_leaf(FILE *fp, mmd_t *node);
+static void		write_stats(FILE *fp, mmd_t *doc);
 
 
 //
@@ -53,15 +104,56 @@ main(int  argc,				// I - Number of command-line arguments
 {
   int		i;			// Looping var
   int		only_body = 0;		// Only output body content?
+  bool		complexity = false;	// Run complexity tests?
+  int		num_threads = -1;	// Number of threads for parallel load
+  size_t	feed_bytes = 0;		// Number of bytes to feed at a time
+  bool		lazy = false;		// Parse inline text lazily?
+  bool		code_text = false;	// Store code blocks as single text nodes?
+  bool		allocator = false;	// Use a counting allocator?
+  bool		binary = false;		// Save and reload the document?
+  bool		index = false;		// Check the node index?
+  bool		reload = false;		// Free the nodes and load again?
+  bool		freeze = false;		// Freeze the document?
+  bool		metadata = false;	// Check loading only the metadata?
+  bool		outline = false;	// Check the document outline?
+  bool		stats = false;		// Show parse statistics?
+  bool		share = false;		// Share strings between documents?
+  mmd_strings_t	*strings = NULL;	// String table
+  FILE		*blocks = NULL;		// Temporary file for loaded blocks
   FILE		*fp = stdout;		// Output file
   const char	*filename = NULL;	// File to load
+  mmd_t		*root = NULL;		// Root node for load
   mmd_t         *doc;                   // Document
   const char    *title;                 // Title
 
 
   for (i = 1; i < argc; i ++)
   {
-    if (!strcmp(argv[i], "--ext"))
+    if (!strcmp(argv[i], "--allocator"))
+    {
+      allocator = true;
+    }
+    else if (!strcmp(argv[i], "--binary"))
+    {
+      binary = true;
+    }
+    else if (!strcmp(argv[i], "--blocks"))
+    {
+      if (!blocks && (blocks = tmpfile()) == NULL)
+      {
+        perror("tmpfile");
+        return (1);
+      }
+    }
+    else if (!strcmp(argv[i], "--code-text"))
+    {
+      code_text = true;
+    }
+    else if (!strcmp(argv[i], "--complexity"))
+    {
+      complexity = true;
+    }
+    else if (!strcmp(argv[i], "--ext"))
     {
       i ++;
       if (i >= argc)
@@ -84,15 +176,82 @@ main(int  argc,				// I - Number of command-line arguments
         return (1);
       }
     }
+    else if (!strcmp(argv[i], "--feed"))
+    {
+      i ++;
+      if (i >= argc || atoi(argv[i]) <= 0)
+      {
+        usage();
+        return (1);
+      }
+
+      feed_bytes = (size_t)atoi(argv[i]);
+    }
+    else if (!strcmp(argv[i], "--freeze"))
+    {
+      freeze = true;
+    }
     else if (!strcmp(argv[i], "--help"))
     {
       usage();
       return (0);
     }
+    else if (!strcmp(argv[i], "--index"))
+    {
+      index = true;
+    }
+    else if (!strcmp(argv[i], "--lazy"))
+    {
+      lazy = true;
+    }
+    else if (!strcmp(argv[i], "--limit"))
+    {
+      static const char * const names[] =
+      {					// Limit names
+        "bytes",
+        "nodes",
+        "depth",
+        "references",
+        "inline"
+      };
+      size_t	j,			// Looping var
+		namelen;		// Length of name
+
+      i ++;
+      if (i >= argc || !strchr(argv[i], '='))
+      {
+        usage();
+        return (1);
+      }
+
+      namelen = (size_t)(strchr(argv[i], '=') - argv[i]);
+
+      for (j = 0; j < (sizeof(names) / sizeof(names[0])); j ++)
+      {
+        if (strlen(names[j]) == namelen && !strncmp(argv[i], names[j], namelen))
+          break;
+      }
+
+      if (j >= (sizeof(names) / sizeof(names[0])))
+      {
+        usage();
+        return (1);
+      }
+
+      mmdSetLimit((mmd_limit_t)j, (size_t)strtoul(argv[i] + namelen + 1, NULL, 10));
+    }
+    else if (!strcmp(argv[i], "--metadata"))
+    {
+      metadata = true;
+    }
     else if (!strcmp(argv[i], "--only-body"))
     {
       only_body = 1;
     }
+    else if (!strcmp(argv[i], "--outline"))
+    {
+      outline = true;
+    }
     else if (!strcmp(argv[i], "-o"))
     {
       i ++;
@@ -108,10 +267,33 @@ main(int  argc,				// I - Number of command-line arguments
         return (1);
       }
     }
+    else if (!strcmp(argv[i], "--reload"))
+    {
+      reload = true;
+    }
     else if (!strcmp(argv[i], "--spec"))
     {
       spec_mode = true;
     }
+    else if (!strcmp(argv[i], "--stats"))
+    {
+      stats = true;
+    }
+    else if (!strcmp(argv[i], "--strings"))
+    {
+      share = true;
+    }
+    else if (!strcmp(argv[i], "--threads"))
+    {
+      i ++;
+      if (i >= argc)
+      {
+        usage();
+        return (1);
+      }
+
+      num_threads = atoi(argv[i]);
+    }
     else if (argv[i][0] == '-')
     {
       printf("Unknown option '%s'.\n", argv[i]);
@@ -127,12 +309,59 @@ main(int  argc,				// I - Number of command-line arguments
       filename = argv[i];
   }
 
-  if (spec_mode)
+  if (lazy)
+    mmdSetOptions(mmdGetOptions() | MMD_OPTION_LAZY_INLINE);
+
+  if (code_text)
+    mmdSetOptions(mmdGetOptions() | MMD_OPTION_CODE_BLOCK_TEXT);
+
+  if (index)
+    mmdSetOptions(mmdGetOptions() | MMD_OPTION_NODE_INDEX);
+
+  if (complexity)
+    return (run_complexity(fp));
+  else if (spec_mode)
     return (run_spec(filename, fp));
+
+  if (share)
+  {
+    if ((strings = mmdStringsNew(allocator ? (mmd_alloc_cb_t)alloc_cb : NULL, &alloc_count)) == NULL)
+    {
+      perror("mmdStringsNew");
+      return (1);
+    }
+  }
+
+  if (allocator || blocks || strings)
+  {
+    // The allocator, block callback, and string table are set on the document,
+    // so create it first...
+    if ((root = mmdNew(allocator ? (mmd_alloc_cb_t)alloc_cb : NULL, &alloc_count)) == NULL)
+    {
+      perror("mmdNew");
+      return (1);
+    }
+
+    if (blocks)
+      mmdSetBlockCallback(root, (mmd_block_cb_t)block_cb, blocks);
+
+    mmdSetStrings(root, strings);
+  }
+
+  if (feed_bytes > 0)
+    doc = load_feed(root, filename, feed_bytes);
+  else if (num_threads >= 0)
+    doc = load_parallel(root, filename, num_threads);
   else if (filename)
-    doc = mmdLoad(NULL, filename);
+    doc = mmdLoad(root, filename);
   else
-    doc = mmdLoadFile(NULL, stdin);
+    doc = mmdLoadFile(root, stdin);
+
+  if (doc && binary)
+    doc = reload_binary(doc);
+
+  if (doc && reload && filename)
+    doc = reload_nodes(doc, filename);
 
   if (!doc)
   {
@@ -140,6 +369,35 @@ main(int  argc,				// I - Number of command-line arguments
     return (1);
   }
 
+  if (freeze)
+  {
+    if (!mmdFreeze(doc))
+    {
+      perror("mmdFreeze");
+      return (1);
+    }
+    else if (mmdLoadString(doc, "Frozen\n"))
+    {
+      fputs("testmmd: Loaded into a frozen document.\n", stderr);
+      return (1);
+    }
+  }
+
+  if (index && !check_index(doc))
+    return (1);
+
+  if (metadata && filename && !check_metadata(doc, filename))
+    return (1);
+
+  if (outline && !check_outline(doc, allocator))
+    return (1);
+
+  if (strings && !check_strings(doc))
+    return (1);
+
+  if (stats)
+    write_stats(stderr, doc);
+
   title = mmdGetMetadata(doc, "title");
 
   if (!only_body)
@@ -201,6 +459,19 @@ main(int  argc,				// I - Number of command-line arguments
 	  "<body>\n", fp);
   }
 
+  if (blocks)
+  {
+    // Copy the blocks that were written while loading...
+    char	buffer[8192];		// Copy buffer
+    size_t	bytes;			// Bytes read
+
+    rewind(blocks);
+    while ((bytes = fread(buffer, 1, sizeof(buffer), blocks)) > 0)
+      fwrite(buffer, 1, bytes, fp);
+
+    fclose(blocks);
+  }
+
   write_block(fp, doc);
 
   if (!only_body)
@@ -213,6 +484,13 @@ main(int  argc,				// I - Number of command-line arguments
     fclose(fp);
 
   mmdFree(doc);
+  mmdStringsFree(strings);
+
+  if (allocator && alloc_count > 0)
+  {
+    fprintf(stderr, "testmmd: %lu allocations were not freed.\n", (unsigned long)alloc_count);
+    return (1);
+  }
 
   return (0);
 }
@@ -272,6 +550,250 @@ add_spec_text(char       *dst,		// I - Destination buffer
 }
 
 
+//
+// 'alloc_cb()' - Allocate memory and count the outstanding allocations.
+//
+
+static void *				// O - Memory or `NULL`
+alloc_cb(size_t *count,			// I - Number of outstanding allocations
+         void   *ptr,			// I - Memory to reallocate or `NULL`
+         size_t bytes)			// I - Number of bytes or `0` to free
+{
+  void	*newptr;			// New memory
+
+
+  if (bytes == 0)
+  {
+    if (ptr)
+    {
+      (*count) --;
+      free(ptr);
+    }
+
+    return (NULL);
+  }
+
+  if ((newptr = realloc(ptr, bytes)) != NULL && !ptr)
+    (*count) ++;
+
+  return (newptr);
+}
+
+
+//
+// 'block_cb()' - Write and free each block as it is loaded.
+//
+// Metadata is kept for the title of the HTML output.  Resetting the document
+// is not allowed during a load and must leave it unchanged.
+//
+
+static void
+block_cb(FILE  *fp,			// I - Temporary file
+         mmd_t *block)			// I - Block
+{
+  mmdReset(mmdGetParent(block));
+
+  if (mmdGetType(block) == MMD_TYPE_METADATA)
+    return;
+
+  write_block(fp, block);
+  mmdFree(block);
+}
+
+
+//
+// 'check_index()' - Check that the node index matches the document.
+//
+
+static bool				// O - `true` if the index matches
+check_index(mmd_t *doc)			// I - Document
+{
+  static const mmd_type_t types[] =	// Indexed node types
+  {
+    MMD_TYPE_HEADING_1,
+    MMD_TYPE_HEADING_2,
+    MMD_TYPE_HEADING_3,
+    MMD_TYPE_HEADING_4,
+    MMD_TYPE_HEADING_5,
+    MMD_TYPE_HEADING_6,
+    MMD_TYPE_CODE_BLOCK,
+    MMD_TYPE_LINKED_TEXT,
+    MMD_TYPE_IMAGE,
+    MMD_TYPE_CHECKBOX
+  };
+  size_t	i,			// Looping var
+		count,			// Number of nodes found
+		num_nodes;		// Number of indexed nodes
+  mmd_t		**nodes,		// Indexed nodes
+		*node;			// Current node
+
+
+  for (i = 0; i < (sizeof(types) / sizeof(types[0])); i ++)
+  {
+    nodes = mmdGetNodesOfType(doc, types[i], &num_nodes);
+
+    for (count = 0, node = mmdGetFirstChild(doc); node; node = next_node(doc, node))
+    {
+      if (mmdGetType(node) == types[i])
+      {
+        if (count >= num_nodes || nodes[count] != node)
+          break;
+
+        count ++;
+      }
+    }
+
+    if (node || count != num_nodes)
+    {
+      fprintf(stderr, "testmmd: Node index for type %d does not match the document.\n", types[i]);
+      return (false);
+    }
+  }
+
+  return (true);
+}
+
+
+//
+// 'check_metadata()' - Check that loading only the metadata gets the same
+//                      metadata as the document.
+//
+
+static bool				// O - `true` if the metadata matches
+check_metadata(mmd_t      *doc,		// I - Document
+               const char *filename)	// I - File to load
+{
+  mmd_t		*meta,			// Metadata document
+		*node,			// Metadata node in document
+		*metanode;		// Metadata node in metadata document
+  bool		ret = true;		// Return value
+
+
+  if ((meta = mmdLoadMetadata(NULL, filename)) == NULL)
+  {
+    perror(filename);
+    return (false);
+  }
+
+  if ((node = mmdGetFirstChild(doc)) != NULL && mmdGetType(node) != MMD_TYPE_METADATA)
+    node = NULL;
+
+  if ((metanode = mmdGetFirstChild(meta)) != NULL && mmdGetNextSibling(metanode))
+  {
+    fputs("testmmd: Metadata document has more than one block.\n", stderr);
+    ret = false;
+  }
+
+  for (node = mmdGetFirstChild(node), metanode = mmdGetFirstChild(metanode); ret && (node || metanode); node = mmdGetNextSibling(node), metanode = mmdGetNextSibling(metanode))
+  {
+    if (!node || !metanode || strcmp(mmdGetText(node), mmdGetText(metanode)))
+    {
+      fprintf(stderr, "testmmd: Metadata \"%s\" does not match \"%s\".\n", node ? mmdGetText(node) : "(null)", metanode ? mmdGetText(metanode) : "(null)");
+      ret = false;
+    }
+  }
+
+  mmdFree(meta);
+
+  return (ret);
+}
+
+
+//
+// 'check_outline()' - Check that the document outline matches the document.
+//
+
+static bool				// O - `true` if the outline matches
+check_outline(mmd_t *doc,		// I - Document
+              bool  allocator)		// I - Free text using the counting allocator?
+{
+  const mmd_heading_t *headings;	// Outline headings
+  size_t	count = 0,		// Number of headings found
+		num_headings;		// Number of outline headings
+  mmd_t		*node;			// Current node
+  mmd_type_t	type;			// Node type
+  char		*text;			// Heading text
+  bool		ret = true;		// Return value
+
+
+  headings = mmdGetOutline(doc, &num_headings);
+
+  for (node = mmdGetFirstChild(doc); node && ret; node = next_node(doc, node))
+  {
+    type = mmdGetType(node);
+
+    if (type >= MMD_TYPE_HEADING_1 && type <= MMD_TYPE_HEADING_6)
+    {
+      text = mmdCopyAllText(node);
+
+      if (count >= num_headings || headings[count].node != node || headings[count].level != (type - MMD_TYPE_HEADING_1 + 1) || strcmp(headings[count].text, text ? text : ""))
+      {
+        fprintf(stderr, "testmmd: Outline heading %u does not match \"%s\".\n", (unsigned)count, text ? text : "");
+        ret = false;
+      }
+
+      if (allocator)
+        alloc_cb(&alloc_count, text, 0);
+      else
+        free(text);
+
+      count ++;
+    }
+  }
+
+  if (ret && count != num_headings)
+  {
+    fprintf(stderr, "testmmd: Outline has %u headings instead of %u.\n", (unsigned)num_headings, (unsigned)count);
+    ret = false;
+  }
+
+  return (ret);
+}
+
+
+//
+// 'check_strings()' - Check that equal URLs and languages share their strings.
+//
+
+static bool				// O - `true` if the strings are shared
+check_strings(mmd_t *doc)		// I - Document
+{
+  mmd_t		*node;			// Current node
+  const char	*url,			// URL of current node
+		*prev_url = NULL,	// Previous URL
+		*language,		// Language of current code block
+		*prev_language = NULL;	// Previous language
+
+
+  for (node = mmdGetFirstChild(doc); node; node = next_node(doc, node))
+  {
+    if ((url = mmdGetURL(node)) != NULL)
+    {
+      if (prev_url && url != prev_url && !strcmp(url, prev_url))
+      {
+        fprintf(stderr, "testmmd: URL \"%s\" is not shared.\n", url);
+        return (false);
+      }
+
+      prev_url = url;
+    }
+
+    if (mmdGetType(node) == MMD_TYPE_CODE_BLOCK && (language = mmdGetExtra(node)) != NULL)
+    {
+      if (prev_language && language != prev_language && !strcmp(language, prev_language))
+      {
+        fprintf(stderr, "testmmd: Language \"%s\" is not shared.\n", language);
+        return (false);
+      }
+
+      prev_language = language;
+    }
+  }
+
+  return (true);
+}
+
+
 //
 // 'indent_puts()' - Write a string to the standard output, indenting each line
 //                   by 8 spaces.
@@ -381,6 +903,105 @@ is_equal(const char *generated,		// I - Generated string
 }
 
 
+//
+// 'load_feed()' - Load a markdown file using an incremental parser.
+//
+
+static mmd_t *				// O - Document or `NULL` on error
+load_feed(mmd_t      *root,		// I - Root node or `NULL` for a new document
+          const char *filename,		// I - File to load or `NULL` for stdin
+          size_t     feed_bytes)	// I - Number of bytes to feed at a time
+{
+  FILE		*infile;		// Input file
+  char		*buffer;		// Read buffer
+  size_t	bytes;			// Bytes read
+  mmd_parser_t	*parser;		// Parser
+
+
+  if (!filename)
+    infile = stdin;
+  else if ((infile = fopen(filename, "rb")) == NULL)
+    return (NULL);
+
+  if ((buffer = malloc(feed_bytes)) == NULL || (parser = mmdParserNew(root)) == NULL)
+  {
+    free(buffer);
+
+    if (infile != stdin)
+      fclose(infile);
+
+    return (NULL);
+  }
+
+  while ((bytes = fread(buffer, 1, feed_bytes, infile)) > 0)
+  {
+    if (!mmdParserFeed(parser, buffer, bytes))
+      break;
+  }
+
+  if (infile != stdin)
+    fclose(infile);
+
+  free(buffer);
+
+  return (mmdParserFinish(parser));
+}
+
+
+//
+// 'load_parallel()' - Load a markdown file using multiple threads.
+//
+
+static mmd_t *				// O - Document or `NULL` on error
+load_parallel(mmd_t      *root,	// I - Root node or `NULL` for a new document
+              const char *filename,	// I - File to load or `NULL` for stdin
+              int        num_threads)	// I - Number of threads
+{
+  FILE		*infile;		// Input file
+  char		*buffer = NULL,		// File buffer
+		*temp;			// New buffer
+  size_t	bytes = 0,		// Bytes in buffer
+		bufsize = 0;		// Size of buffer
+  mmd_t		*doc;			// Document
+
+
+  if (!filename)
+    infile = stdin;
+  else if ((infile = fopen(filename, "rb")) == NULL)
+    return (NULL);
+
+  do
+  {
+    if (bytes >= bufsize)
+    {
+      bufsize += 65536;
+
+      if ((temp = realloc(buffer, bufsize)) == NULL)
+      {
+        free(buffer);
+        buffer = NULL;
+        break;
+      }
+
+      buffer = temp;
+    }
+  }
+  while ((bytes += fread(buffer + bytes, 1, bufsize - bytes, infile)) >= bufsize);
+
+  if (infile != stdin)
+    fclose(infile);
+
+  if (!buffer)
+    return (NULL);
+
+  doc = mmdLoadParallel(root, buffer, bytes, num_threads);
+
+  free(buffer);
+
+  return (doc);
+}
+
+
 //
 // 'make_anchor()' - Make an anchor for internal links.
 //
@@ -409,6 +1030,154 @@ make_anchor(const char *text)           // I - Text
 }
 
 
+//
+// 'next_node()' - Find the next node in the document, in depth-first order.
+//
+
+static mmd_t *				// O - Next node or `NULL` if none
+next_node(mmd_t *doc,			// I - Document
+          mmd_t *node)			// I - Current node
+{
+  mmd_t		*next;			// Next node
+
+
+  if ((next = mmdGetFirstChild(node)) == NULL)
+  {
+    for (next = node; next != doc && !mmdGetNextSibling(next); next = mmdGetParent(next));
+
+    next = next == doc ? NULL : mmdGetNextSibling(next);
+  }
+
+  return (next);
+}
+
+
+//
+// 'reload_binary()' - Save a document and load it again.
+//
+
+static mmd_t *				// O - Document or `NULL` on error
+reload_binary(mmd_t *doc)		// I - Document
+{
+  FILE		*fp;			// Saved file
+  char		*buffer = NULL;		// File buffer
+  long		bytes;			// Size of file
+  mmd_t		*loaded = NULL;		// Loaded document
+
+
+  if (!mmdSave(doc, "testmmd.bin"))
+  {
+    mmdFree(doc);
+    return (NULL);
+  }
+
+  // Load into the same document so that its allocator and settings are kept...
+  mmdReset(doc);
+
+  if ((fp = fopen("testmmd.bin", "rb")) != NULL)
+  {
+    if (!fseek(fp, 0, SEEK_END) && (bytes = ftell(fp)) > 0 && !fseek(fp, 0, SEEK_SET) && (buffer = malloc((size_t)bytes)) != NULL && fread(buffer, 1, (size_t)bytes, fp) == (size_t)bytes)
+      loaded = mmdLoadBinary(doc, buffer, (size_t)bytes);
+
+    fclose(fp);
+  }
+
+  free(buffer);
+  remove("testmmd.bin");
+
+  if (!loaded)
+    mmdFree(doc);
+
+  return (loaded);
+}
+
+
+//
+// 'reload_nodes()' - Free the nodes of a document and load the file again.
+//
+// The second load reuses the freed nodes.
+//
+
+static mmd_t *				// O - Document or `NULL` on error
+reload_nodes(mmd_t      *doc,		// I - Document
+             const char *filename)	// I - File to load
+{
+  mmd_t		*node;			// Current node
+
+
+  while ((node = mmdGetFirstChild(doc)) != NULL)
+    mmdFree(node);
+
+  if (!mmdLoad(doc, filename))
+  {
+    mmdFree(doc);
+    return (NULL);
+  }
+
+  return (doc);
+}
+
+
+//
+// 'run_complexity()' - Check that pathological inputs load in linear time.
+//
+// Each input shape is loaded with a repeat count of N and 4N; linear code
+// takes about 4 times as long for the larger input, quadratic code about 16
+// times as long.  N is kept small enough that each paragraph fits in a single
+// line buffer, with enough blocks that N takes at least 20ms to load.  A shape
+// that looks too slow is timed again, keeping the best times for N and 4N,
+// before it fails so that a busy machine does not fail the test.
+//
+
+static int				// O - Exit status
+run_complexity(FILE *logfile)		// I - Log file
+{
+  size_t	shape,			// Current shape
+		count;			// Repeat count for N
+  int		tries,			// Number of tries
+		failed = 0;		// Number of failed tests
+  double	t1,			// Time for N
+		t4,			// Time for 4N
+		temp;			// Time for retry
+
+
+  for (shape = 0; shape < (sizeof(complexity_shapes) / sizeof(complexity_shapes[0])); shape ++)
+  {
+    fprintf(logfile, "    %s: ", complexity_shapes[shape].name);
+    fflush(logfile);
+
+    count = complexity_shapes[shape].count;
+    t1    = time_load(shape, count);
+    t4    = time_load(shape, 4 * count);
+
+    for (tries = 0; tries < 2 && t1 >= 0.0 && t4 > 6.0 * t1; tries ++)
+    {
+      if ((temp = time_load(shape, count)) >= 0.0 && temp < t1)
+        t1 = temp;
+      if ((temp = time_load(shape, 4 * count)) >= 0.0 && temp < t4)
+        t4 = temp;
+    }
+
+    if (t1 < 0.0 || t4 < 0.0)
+    {
+      fputs("FAIL (unable to load)\n", logfile);
+      failed ++;
+    }
+    else if (t4 > 6.0 * t1)
+    {
+      fprintf(logfile, "FAIL (%.3fs for N, %.3fs for 4N)\n", t1, t4);
+      failed ++;
+    }
+    else
+    {
+      fprintf(logfile, "PASS (%.3fs for N, %.3fs for 4N)\n", t1, t4);
+    }
+  }
+
+  return (failed != 0);
+}
+
+
 //
 // 'run_spec()' - Run through all of the examples in the specified markdown
 //                file.
@@ -578,6 +1347,110 @@ run_spec(const char *filename,		// I - Markdown spec file
 }
 
 
+//
+// 'time_load()' - Time loading a number of blocks using the given shape.
+//
+// The document is loaded once and then reset, and the best of five more loads
+// is reported to reduce noise from other processes.
+//
+
+static double				// O - Load time in seconds or -1.0 on error
+time_load(size_t shape,			// I - Input shape
+          size_t count)			// I - Repeat count
+{
+  const char	*prefix = complexity_shapes[shape].prefix,
+					// Text before repeated text
+		*repeat = complexity_shapes[shape].repeat,
+					// Repeated text
+		*suffix = complexity_shapes[shape].suffix;
+					// Text after repeated text
+  size_t	blocks = complexity_shapes[shape].blocks,
+					// Number of blocks
+		prefixlen = strlen(prefix),
+					// Length of prefix
+		repeatlen = strlen(repeat) + 10,
+					// Maximum length of repeated text
+		suffixlen = strlen(suffix),
+					// Length of suffix
+		number = 0,		// Number for repeated text
+		i, j;			// Looping vars
+  bool		numbered = strchr(repeat, '%') != NULL;
+					// Number the repeated text?
+  char		*buffer,		// Input buffer
+		*bufptr;		// Pointer into buffer
+  mmd_t		*doc,			// Document
+		*loaded;		// Result of load
+  clock_t	start,			// Start time
+		elapsed,		// Elapsed time
+		best = 0;		// Best time
+  int		tries;			// Number of tries
+
+
+  // Build the blocks with the repeated text...
+  if ((buffer = malloc(blocks * (prefixlen + count * repeatlen + suffixlen + 2) + 1)) == NULL)
+    return (-1.0);
+
+  for (i = 0, bufptr = buffer; i < blocks; i ++)
+  {
+    memcpy(bufptr, prefix, prefixlen);
+    bufptr += prefixlen;
+
+    for (j = 0; j < count; j ++)
+    {
+      if (numbered)
+      {
+        snprintf(bufptr, repeatlen + 1, repeat, (unsigned)number ++);
+        bufptr += strlen(bufptr);
+      }
+      else
+      {
+        memcpy(bufptr, repeat, repeatlen - 10);
+        bufptr += repeatlen - 10;
+      }
+    }
+
+    memcpy(bufptr, suffix, suffixlen);
+    bufptr += suffixlen;
+
+    *bufptr++ = '\n';
+    *bufptr++ = '\n';
+  }
+
+  *bufptr = '\0';
+
+  // Load it once to allocate the document's memory, then reset and load it
+  // again so that page faults don't count against the larger input...
+  if ((doc = mmdLoadString(NULL, buffer)) == NULL)
+  {
+    free(buffer);
+    return (-1.0);
+  }
+
+  for (tries = 0; tries < 5; tries ++)
+  {
+    mmdReset(doc);
+
+    start   = clock();
+    loaded  = mmdLoadString(doc, buffer);
+    elapsed = clock() - start;
+
+    if (!loaded)
+      break;
+
+    if (tries == 0 || elapsed < best)
+      best = elapsed;
+  }
+
+  mmdFree(doc);
+  free(buffer);
+
+  if (tries < 5)
+    return (-1.0);
+  else
+    return ((double)best / CLOCKS_PER_SEC);
+}
+
+
 //
 // 'usage()' - Show usage...
 //
@@ -587,12 +1460,30 @@ usage(void)
 {
   puts("Usage: ./testmmd [options] [filename.md] > filename.html");
   puts("Options:");
+  puts("--allocator       Check that all memory is freed using a counting allocator");
+  puts("--binary          Save and reload the document before writing it");
+  puts("--blocks          Write and free each block as it is loaded");
+  puts("--code-text       Store each code block as a single text node");
+  puts("--complexity      Check that pathological inputs load in linear time");
   puts("--ext all         Support all markdown extensions");
   puts("--ext none        Support no markdown extensions");
+  puts("--feed N          Load using an incremental parser fed N bytes at a time");
+  puts("--freeze          Freeze the document before writing it");
   puts("--help            Show help");
+  puts("--index           Check the node index against the document");
+  puts("--lazy            Parse inline text when first accessed");
+  puts("--limit name=value");
+  puts("                  Set a parse limit (bytes, nodes, depth, references, or");
+  puts("                  inline)");
+  puts("--metadata        Check that loading only the metadata gets the same metadata");
   puts("--only-body       Only output body content");
+  puts("--outline         Check the document outline against the document");
+  puts("--reload          Free the nodes and load the file again before writing it");
   puts("--spec            Markdown file is a specification with example input and");
   puts("                  expected HTML output");
+  puts("--stats           Show parse statistics on the standard error");
+  puts("--strings         Store URLs and code languages in a string table");
+  puts("--threads N       Load using up to N threads (0 for automatic)");
   puts("-o filename.html  Send output to file instead of stdout");
 }
 
@@ -888,3 +1779,33 @@ write_leaf(FILE  *fp,			// I - Output file
       fputs("</a>", fp);
   }
 }
+
+
+//
+// 'write_stats()' - Write the parse statistics for a document.
+//
+
+static void
+write_stats(FILE  *fp,			// I - Output file
+            mmd_t *doc)			// I - Document
+{
+  const mmd_stats_t *stats = mmdGetStats(doc);
+					// Parse statistics
+  int		type;			// Node type
+  size_t	num_nodes = 0;		// Total number of nodes
+
+
+  for (type = 0; type <= MMD_TYPE_CHECKBOX; type ++)
+    num_nodes += stats->nodes[type];
+
+  fprintf(fp, "bytes=%lu lines=%lu refills=%lu continuations=%lu\n", (unsigned long)stats->bytes, (unsigned long)stats->lines, (unsigned long)stats->refills, (unsigned long)stats->continuations);
+  fprintf(fp, "nodes=%lu references=%lu pending=%lu resolved=%lu\n", (unsigned long)num_nodes, (unsigned long)stats->references, (unsigned long)stats->pending, (unsigned long)stats->resolved);
+  fprintf(fp, "allocs=%lu alloc_bytes=%lu chunks=%lu\n", (unsigned long)stats->allocs, (unsigned long)stats->alloc_bytes, (unsigned long)stats->chunks);
+  fprintf(fp, "block_time=%.6f inline_time=%.6f\n", stats->block_time, stats->inline_time);
+
+  for (type = 0; type <= MMD_TYPE_CHECKBOX; type ++)
+  {
+    if (stats->nodes[type])
+      fprintf(fp, "nodes[%d]=%lu\n", type, (unsigned long)stats->nodes[type]);
+  }
+}